@@ -11,12 +11,20 @@
 *******************************************************************************/
 #include <htc.h>
 #include "system.h"		// header of hardware pin, Crystal speed, baud rate
+#include "timer0.h"		// header file for timer0, use as 1ms system tick
 #include "timer1.h"		// header file for timer1, use as counter for encoder
 #include "uart.h"		// header file for UART, serial communication
 #include "adc.h"		// header file for ADC
 #include "pwm.h"		// header file for PWM, speed control
+#include "ramp.h"		// header file for motor speed ramp
 #include "lcd.h"		// header file for LCD
 #include "skps.h"		// header file for SKPS
+#include "event.h"		// header file for button events
+#include "sched.h"		// header file for task scheduler
+#include "blreset.h"		// header file for brushless driver reset
+#include "bus.h"		// header file for PORTD bus, LCD and relay latch
+#include "relay.h"		// header file for relays and MD3/MD4 behind the latch
+#include "limit.h"		// header file for limit switch cut-off
 
 /*******************************************************************************
 * DEVICE CONFIGURATION WORDS FOR PIC16F887                                     *
@@ -76,24 +84,14 @@ __CONFIG(HS &			// External Crystal at High Speed
 */
 #define GEAR			1				// gear type
 
-#define left_speed(a)	set_pwm1(a)		// left motor at PORT1
-#define right_speed(a) 	set_pwm2(a)		// right motor at PORT2
-#define DIRL			DIR1			// direction pin for Left motor
-#define	DIRR			DIR2			// direction pin for Right motor
 #define RUNL			RUN1			// RUN/BRAKE pin for Left motor
 #define RUNR			RUN2			// RUN/BRAKE pin for Right motor
 
-#define	LIMIT1			SEN1			// Upper limit switch for motor 1
-#define LIMIT2			SEN2			// Lower limit switch for motor 1
-#define	LIMIT3			SEN3			// Upper limit switch for motor 2
-#define LIMIT4			SEN4			// Lower limit switch for motor 2
-
 
 /*******************************************************************************
 * PRIVATE FUNCTION PROTOTYPES                                                  *
 *******************************************************************************/
 //basic function for MC40SE
-void delay_ms(unsigned int ui_value);
 void beep(unsigned char uc_count);
 void mc40se_init(void);
 
@@ -101,9 +99,6 @@ void mc40se_init(void);
 void brushless(unsigned char uc_port_number, unsigned char uc_motor_status, unsigned char uc_motor_dir, unsigned int ui_speed);
 void brush(unsigned char uc_port_number, unsigned char uc_motor_status, unsigned char uc_motor_dir, unsigned int ui_speed);
 void reset_brushless(void);
-void relay_on(unsigned char uc_relay_number);
-void relay_off(unsigned char uc_relay_number);
-void relay_off_all(void);
 
 // robot locomotion, navigation
 void forward(void);
@@ -114,14 +109,59 @@ void stop(void);
 void run(void);
 void motorspeed(unsigned int m_left, unsigned int m_right);
 
-//functions for manual
-void manual_demo(void);
+//tasks for manual
+void task_ps2(void);
+void task_drive(void);
+void task_display(void);
+void task_beep(void);
 
 
 /*******************************************************************************
 * Global Variables                                                             *
 *******************************************************************************/
 unsigned char mLeft = 0, mRight = 0;	//motor speed
+unsigned int speed = SPEED;				//speed set with the right joystick
+unsigned char b_dirl = 0, b_dirr = 0;	//DIR1 and DIR2 for the locomotion, set by the ramp when the motor is stopped
+
+// SKPS commands taken by task_ps2 from the SKPS poller
+const unsigned char cuc_manual_commands[] = {
+	p_select, p_start,
+	p_joy_lu, p_joy_ld, p_joy_ll, p_joy_lr, p_joy_ru, p_joy_rd,
+	p_r1, p_r2, p_l1, p_l2,
+	p_up, p_down, p_square, p_circle
+};
+SKPS_SNAPSHOT s_ps2;					// latest state of the PS2 controller
+unsigned char b_start_pressed = 0;		// START pressed, set by task_ps2
+unsigned char b_select_pressed = 0;		// SELECT pressed, set by task_ps2
+unsigned char b_driving = 0;			// robot is driven from the PS2 controller
+unsigned char uc_beeps = 0;				// beeps waiting for task_beep
+
+// state of the protothread tasks
+PT pt_drive = 0;
+PT pt_beep = 0;
+unsigned int ui_drive_wait;
+unsigned int ui_beep_wait;
+
+// tasks of the manual demo, a task earlier in the list runs first when both are due
+const SCHED_TASK cs_manual_tasks[] = {
+	{task_ps2, 20, 2},			// PS2 state from the SKPS poller, 20ms
+	{task_drive, 20, 8},		// motors and relays, 20ms
+	{task_beep, 10, 1},			// buzzer
+	{task_display, 200, 3}		// speed on the LCD
+};
+
+// SKPS background poll schedule, motion controls are read every poll cycle
+const SKPS_POLL_ENTRY cs_manual_schedule[] = {
+	{p_joy_lu, SKPS_POLL_FAST},		{p_joy_ld, SKPS_POLL_FAST},
+	{p_joy_ll, SKPS_POLL_FAST},		{p_joy_lr, SKPS_POLL_FAST},
+	{p_up, SKPS_POLL_FAST},			{p_down, SKPS_POLL_FAST},
+	{p_square, SKPS_POLL_FAST},		{p_circle, SKPS_POLL_FAST},
+	{p_r1, SKPS_POLL_NORMAL},		{p_r2, SKPS_POLL_NORMAL},
+	{p_l1, SKPS_POLL_NORMAL},		{p_l2, SKPS_POLL_NORMAL},
+	{p_joy_ru, SKPS_POLL_NORMAL},	{p_joy_rd, SKPS_POLL_NORMAL},
+	{p_select, SKPS_POLL_SLOW},		{p_start, SKPS_POLL_SLOW},
+	{p_con_status, SKPS_POLL_SLOW}
+};
 /*******************************************************************************
 * MAIN FUNCTION                                                                *
 *******************************************************************************/
@@ -130,8 +170,14 @@ int main(void)
 	// Initialize PIC16F887 to correct Input/Output based on MC40SE on board interface
 	mc40se_init();
 	
+	// Initialize Timer 0, 1ms system tick, delay_ms runs on it.
+	timer0_init();
+	
+	// Initialize the PORTD bus, shared by the LCD and the relays.
+	bus_init();
+	
 	// off all relays
-	relay_off_all();	
+	relay_init();	
 	
 	// Initialize ADC.
 	adc_init();	
@@ -145,12 +191,27 @@ int main(void)
 	// Initialize PWM.
 	timer1_init();
 	
+	// Initialize button events, use the 1ms system tick.
+	event_init();
+	
+	// Cut the relays at the limit switches, after the ADC, relays and events.
+	limit_init();
+	
+	// Initialize motor speed ramp, use the 1ms system tick.
+	ramp_init();
+	
 	// Initialize the LCD.
 	lcd_init();		
 	
 	// Initialize bruhsless motor port
 	brushless(PORT1, BRAKE, CW, 0);
 	brushless(PORT2, BRAKE, CCW, 0);
+	
+	// stop the robot if SKPS stops answering
+	skps_set_failsafe(stop);
+	
+	// read SKPS in the background, task_ps2 takes the latest values
+	skps_poll_start(cs_manual_schedule, sizeof(cs_manual_schedule) / sizeof(cs_manual_schedule[0]));
 			
 	// Display the messages and beep twice.		
 	lcd_clear_msg(" MC40SE\n Manual");
@@ -161,9 +222,11 @@ int main(void)
 	// press SW2 enter this mode
 	lcd_clear_msg(" Manual\n  Demo!");		
 
+	// run the tasks of the manual demo
+	sched_start(cs_manual_tasks, sizeof(cs_manual_tasks) / sizeof(cs_manual_tasks[0]));
 	while(1)	//infinite loop
 	{
-		manual_demo();	// call manual demo function
+		sched_run();
 	}//while(1)
 	
 	while(1) continue;	// infinite loop to prevent PIC from reset
@@ -171,27 +234,6 @@ int main(void)
 
 
 
-/*******************************************************************************
-* PRIVATE FUNCTION: delay_ms
-*
-* PARAMETERS:
-* ~ ui_value	- The period for the delay in miliseconds.
-*
-* RETURN:
-* ~ void
-*
-* DESCRIPTIONS:
-* Delay in miliseconds.
-*
-*******************************************************************************/
-void delay_ms(unsigned int ui_value)
-{
-	while (ui_value-- > 0) {
-		__delay_ms(1);
-	}	
-}
-
-
 /*******************************************************************************
 * PRIVATE FUNCTION: beep
 *
@@ -264,6 +306,7 @@ void mc40se_init(void)
 *
 * DESCRIPTIONS:
 * control brushless motor, suitable for Vexta or LINIX brushless motor connect to MC40SE
+* RUN is ignored while the drivers are being reset (uc_blreset_busy), call again after.
 *
 *******************************************************************************/
 void brushless(unsigned char uc_port_number, unsigned char uc_motor_status, unsigned char uc_motor_dir, unsigned int ui_speed)
@@ -272,51 +315,57 @@ void brushless(unsigned char uc_port_number, unsigned char uc_motor_status, unsi
 	{
 		if(uc_motor_status == RUN)
 		{		
-			RUN1 = 0;	// active low		
+			if(uc_blreset_busy() == 0)	// not while the driver is being reset
+			{
+				RUN1 = 0;	// active low
+			}
 		}
 		else if(uc_motor_status == BRAKE)
 		{
-			RUN1 = 1;	// activate low	
-			BL_R = 0;	//after stop, reset the brushless
-			__delay_ms(5);	// this reset can only be used if internal crystal is used
-			BL_R = 1;		// and JP27 (BL-R) is connected
-			__delay_ms(10);				
+			if(RUN1 == 0)	// was running
+			{
+				RUN1 = 1;	// activate low	
+				blreset_start();	//after stop, reset the brushless, this reset can only be used
+			}					//if internal crystal is used and JP27 (BL-R) is connected
 		}
 		
+		// ramp to the new speed, DIR1 changes when the motor passes zero
 		if(uc_motor_dir == CW)
 		{
-			DIR1 = 1;
+			ramp_set1(ui_speed);
 		}
 		else if (uc_motor_dir == CCW)
 		{
-			DIR1 = 0;
+			ramp_set1(-(int)ui_speed);
 		}
-		set_pwm1(ui_speed);
 	}
 	else if(uc_port_number == PORT2)
 	{
 		if(uc_motor_status == RUN)
 		{		
-			RUN2 = 0;	// active low		
+			if(uc_blreset_busy() == 0)	// not while the driver is being reset
+			{
+				RUN2 = 0;	// active low
+			}
 		}
 		else if(uc_motor_status == BRAKE)
 		{
-			RUN2 = 1;	// activate low	
-			BL_R = 0;	//after stop, reset the brushless
-			__delay_ms(5);	// this reset can only be used if internal crystal is used
-			BL_R = 1;		// and JP27 (BL-R) is connected
-			__delay_ms(10);				
+			if(RUN2 == 0)	// was running
+			{
+				RUN2 = 1;	// activate low	
+				blreset_start();	//after stop, reset the brushless, this reset can only be used
+			}					//if internal crystal is used and JP27 (BL-R) is connected
 		}
 		
+		// ramp to the new speed, DIR2 changes when the motor passes zero
 		if(uc_motor_dir == CW)
 		{
-			DIR2 = 1;
+			ramp_set2(ui_speed);
 		}
 		else if (uc_motor_dir == CCW)
 		{
-			DIR2 = 0;
+			ramp_set2(-(int)ui_speed);
 		}
-		set_pwm2(ui_speed);
 	}
 }	
 /*******************************************************************************
@@ -335,12 +384,7 @@ void brushless(unsigned char uc_port_number, unsigned char uc_motor_status, unsi
 *******************************************************************************/
 void reset_brushless(void)
 {
-	#if defined (_16F887)
-	BL_R = 0;
-	__delay_ms(5);
-	BL_R = 1;
-	__delay_ms(10);	
-	#endif	
+	blreset_start();	// BL_R pulse timed by the 1ms system tick, returns at once
 }
 /*******************************************************************************
 * PRIVATE FUNCTION: brush
@@ -405,78 +449,39 @@ void brush(unsigned char uc_port_number, unsigned char uc_motor_status, unsigned
 		set_pwm2(ui_speed);
 	}	
 }	
+	
 /*******************************************************************************
-* PRIVATE FUNCTION: relay_on
+* PRIVATE FUNCTION: task_ps2
 *
 * PARAMETERS:
-* ~ unsigned char uc_relay_number - relay that needed to be activate, from 1-8
-*
-* RETURN:
 * ~ void
 *
-* DESCRIPTIONS:
-* activate relay.
-*
-*******************************************************************************/
-void relay_on(unsigned char uc_relay_number)
-{
-	LATCH = 0;	// hold the state of latch
-	if(uc_relay_number > 0)
-	{
-	PORTD = PORTD | (0b00000001<< (uc_relay_number - 1));
-	LATCH = 1;	// transfer the new output to relay
-	delay_ms(1);
-	LATCH = 0;	// hold the output of latch
-	}
-}	
-/*******************************************************************************
-* PRIVATE FUNCTION: relay_off
-*
-* PARAMETERS:
-* ~ unsigned char uc_relay_number - relay that needed to be deactivate, from 1-8
-*
 * RETURN:
 * ~ void
 *
 * DESCRIPTIONS:
-* Deactivate relay
+* Task, take the latest state of the PS2 controller from the SKPS poller into
+* s_ps2 and turn the presses of START and SELECT into flags for task_drive.
+* Beep when a limit switch cuts a relay.
 *
 *******************************************************************************/
-void relay_off(unsigned char uc_relay_number)
+void task_ps2(void)
 {
-	LATCH = 0;	// hold the state of latch
-	if(uc_relay_number > 0)
-	{
-	PORTD = PORTD & (~(0b00000001<< (uc_relay_number -1)));
-	LATCH = 1;	// transfer the new output to relay
-	delay_ms(1);
-	LATCH = 0;	// hold the output of latch
+	EVENT s_event;
+	
+	uc_skps_snapshot(&s_ps2, cuc_manual_commands, sizeof(cuc_manual_commands));
+	event_skps_update(s_ps2.ui_buttons);
+	
+	while (uc_event_get(&s_event) == 1) {
+		if (s_event.uc_type == EVENT_CUTOFF) uc_beeps = 1;	// a limit switch stopped a relay motor
+		if (s_event.uc_type != EVENT_PRESS) continue;
+		if (s_event.uc_id == p_start) b_start_pressed = 1;
+		else if (s_event.uc_id == p_select) b_select_pressed = 1;
 	}
-}	
-/*******************************************************************************
-* PRIVATE FUNCTION: relay_off_all
-*
-* PARAMETERS:
-* ~ void
-*
-* RETURN:
-* ~ void
-*
-* DESCRIPTIONS:
-* deactivate all relays.
-*
-*******************************************************************************/
-void relay_off_all(void)
-{
-	LATCH = 0;	// hold the output of latch
-	PORTD = 0; 	// Off all relays
-	LATCH = 1;	// enable latch to read input and transfer to output
-	delay_ms(5);
-	LATCH = 0;	// hold the output of latch
 }
-	
+
 /*******************************************************************************
-* PRIVATE FUNCTION: manual_demo
+* PRIVATE FUNCTION: task_drive
 *
 * PARAMETERS:
 * ~ void
@@ -485,208 +490,270 @@ void relay_off_all(void)
 * ~ void
 *
 * DESCRIPTIONS:
-* to demo PS2 control using SKPS for manual robot
+* Task, to demo PS2 control using SKPS for manual robot. Wait for the PS2
+* controller and START, then drive the motors and relays from the PS2
+* controller on every run until SELECT is pressed.
 *
 *******************************************************************************/
-void manual_demo(void)
+void task_drive(void)
 {
 	unsigned char up_v, down_v, left_v, right_v, speed_up, speed_down; //variable for joy stick value
-	unsigned int speed = SPEED;		//variable to store speed value, 	
-	lcd_clear_msg(" Manual\nSKPS+PS2");	// SKPS and PS2 must be connected to MC40Se
-	delay_ms(500);
-	
-	while(uc_skps(p_con_status) == 0) continue; //wait until status of PS2 is connected	
-	lcd_clear_msg("PS2 OK\nSTART=ON");	// press START on PS2 to get started
-	delay_ms(1000);
-		
-	while(uc_skps(p_start) == 1) continue; //wait until START button of PS2 is press
 	
-	beep(2);
-	lcd_2ndline();
-	lcd_putstr("SEL=out ");		// Press SELECT button on PS2 to exit this demo
-		
-	while(uc_skps(p_select) == 1)
+	PT_BEGIN(pt_drive);
+	while(1)
 	{
-		//read joy stick value process		
-		up_v=uc_skps(p_joy_lu);		// read analog value of left joystick, up axis, from 0 - 100
-		down_v=uc_skps(p_joy_ld);	// read analog value of left joystick, down axis, from 0 - 100
-		left_v=uc_skps(p_joy_ll);	// read analog value of left joystick, left axis, from 0 - 100
-		right_v=uc_skps(p_joy_lr);	// read analog value of left joystick, right axis, from 0 - 100	
-		speed_up=uc_skps(p_joy_ru);		// read analog value of right joystick, up axis, from 0 - 100
-		speed_down=uc_skps(p_joy_rd);	// read analog value of right joystick, down axis, from 0 - 100
-	
+		lcd_clear_msg(" Manual\nSKPS+PS2");	// SKPS and PS2 must be connected to MC40Se
+		PT_DELAY(pt_drive, ui_drive_wait, 500);
 		
-		// Control motor at relay, this is Right 1 front button
-		if ((uc_skps(p_r1)== 0) && (LIMIT1 == 1))	//if R1 is press and Limit switch 1 is not touch
-		{
-			relay_on(1);
-			relay_off(2);	
-		}	
+		PT_WAIT_UNTIL(pt_drive, uc_skps(p_con_status) != 0); //wait until status of PS2 is connected	
+		lcd_clear_msg("PS2 OK\nSTART=ON");	// press START on PS2 to get started
+		PT_DELAY(pt_drive, ui_drive_wait, 1000);
 		
-		// this is Right 2 front button
-		else if ((uc_skps(p_r2)==0) && (LIMIT2 == 1)) //if R2 is press and limit switch 2 is not touch
-		{
-			relay_on(2);
-			relay_off(1);
-		}
-		// if both neither switch is press, off relay 1&2		
-		else {
-			relay_off(1);
-			relay_off(2);
-		}	
+		b_start_pressed = 0;		// only a new press of START counts
+		PT_WAIT_UNTIL(pt_drive, b_start_pressed == 1); //wait until START button of PS2 is press
 		
-		// check if Left front button is pressed
-		if ((uc_skps(p_l1)== 0) && (LIMIT3 == 1)) // if L1 is press and limit switch 3 is not touch
-		{
-			relay_on(3);
-			relay_off(4);
-		}		
-		else if ((uc_skps(p_l2)==0) && (LIMIT4 == 1)) // if L2 is press and limit switch 4 is not touch
-		{
-			relay_on(4);
-			relay_off(3);
-		}		
-		else {
-			relay_off(3);
-			relay_off(4);
-		}		
+		uc_beeps = 2;
+		lcd_2ndline();
+		lcd_putstr("SEL=out ");		// Press SELECT button on PS2 to exit this demo
+		speed = SPEED;
+		b_driving = 1;
 		
-		//to change speed, default speed is 300, speed range is 10-bit WM, from 0 to 1023
-		if(speed_up > 30)	// if right joystick is being push to up axis
+		b_select_pressed = 0;
+		while(b_select_pressed == 0)	// SELECT to exit
 		{
-			if(speed < 1015) 
+			//read joy stick value process		
+			up_v=SKPS_AXIS(s_ps2, p_joy_lu);		// read analog value of left joystick, up axis, from 0 - 100
+			down_v=SKPS_AXIS(s_ps2, p_joy_ld);		// read analog value of left joystick, down axis, from 0 - 100
+			left_v=SKPS_AXIS(s_ps2, p_joy_ll);		// read analog value of left joystick, left axis, from 0 - 100
+			right_v=SKPS_AXIS(s_ps2, p_joy_lr);		// read analog value of left joystick, right axis, from 0 - 100	
+			speed_up=SKPS_AXIS(s_ps2, p_joy_ru);	// read analog value of right joystick, up axis, from 0 - 100
+			speed_down=SKPS_AXIS(s_ps2, p_joy_rd);	// read analog value of right joystick, down axis, from 0 - 100
+	
+		
+			// Control motor at relay, this is Right 1 front button
+			if (SKPS_PRESSED(s_ps2, p_r1) && (LIMIT1 == 1))	//if R1 is press and Limit switch 1 is not touch
 			{
-				speed += 5;
-				delay_ms(1);
-			}			
-		}
-		else if (speed_down > 30) // if right joystick is being push down axis
-		{
-			if(speed > 5) 
+				relay_stage_on(1);
+				relay_stage_off(2);	
+			}	
+		
+			// this is Right 2 front button
+			else if (SKPS_PRESSED(s_ps2, p_r2) && (LIMIT2 == 1)) //if R2 is press and limit switch 2 is not touch
 			{
-				speed -=5;
-				delay_ms(1);
+				relay_stage_on(2);
+				relay_stage_off(1);
+			}
+			// if both neither switch is press, off relay 1&2		
+			else {
+				relay_stage_off(1);
+				relay_stage_off(2);
 			}	
-		}		
-		//navigation using left and right top 4 buttons
-		if(uc_skps(p_up)== 0)	// if up arrow button is press
-		{
-			if (uc_skps(p_square)==0) {	// if up & square buttons are press
-				//left turn
-				forward();
-				motorspeed(0,speed);
+		
+			// check if Left front button is pressed
+			if (SKPS_PRESSED(s_ps2, p_l1) && (LIMIT3 == 1)) // if L1 is press and limit switch 3 is not touch
+			{
+				relay_stage_on(3);
+				relay_stage_off(4);
+			}		
+			else if (SKPS_PRESSED(s_ps2, p_l2) && (LIMIT4 == 1)) // if L2 is press and limit switch 4 is not touch
+			{
+				relay_stage_on(4);
+				relay_stage_off(3);
+			}		
+			else {
+				relay_stage_off(3);
+				relay_stage_off(4);
 			}
-			else if (uc_skps(p_circle)==0) {
-				//right turn
-				forward();
-				motorspeed(speed,0);
+			relay_commit();		// one latch strobe, only if a relay changed
+		
+			//to change speed, default speed is 300, speed range is 10-bit WM, from 0 to 1023
+			if(speed_up > 30)	// if right joystick is being push to up axis
+			{
+				if(speed < 1015) 
+				{
+					speed += 5;
+				}			
+			}
+			else if (speed_down > 30) // if right joystick is being push down axis
+			{
+				if(speed > 5) 
+				{
+					speed -=5;
+				}	
+			}		
+			//navigation using left and right top 4 buttons
+			if(SKPS_PRESSED(s_ps2, p_up))	// if up arrow button is press
+			{
+				if (SKPS_PRESSED(s_ps2, p_square)) {	// if up & square buttons are press
+					//left turn
+					forward();
+					motorspeed(0,speed);
+				}
+				else if (SKPS_PRESSED(s_ps2, p_circle)) {
+					//right turn
+					forward();
+					motorspeed(speed,0);
+				}
+				else {	
+					//forward
+					forward();
+					motorspeed(speed,speed);
+				}	
 			}
-			else {	
-				//forward
-				forward();
-				motorspeed(speed,speed);
-			}	
-		}
 		
-		// if down arrow button is press, reverse
-		else if(uc_skps(p_down) == 0)
-		{	
-			//backward
-			reverse();
-			motorspeed(speed,speed);
-		}
+			// if down arrow button is press, reverse
+			else if(SKPS_PRESSED(s_ps2, p_down))
+			{	
+				//backward
+				reverse();
+				motorspeed(speed,speed);
+			}
 		
-		// if square button only being press, pivot left
-		else if(uc_skps(p_square) == 0)
-		{	
-			//pivot left
-			pivot_left();
-			motorspeed(speed,speed);
-		}
+			// if square button only being press, pivot left
+			else if(SKPS_PRESSED(s_ps2, p_square))
+			{	
+				//pivot left
+				pivot_left();
+				motorspeed(speed,speed);
+			}
 		
-		// if circle button only being press, pivot right
-		else if(uc_skps(p_circle) == 0)
-		{
-			//pivot right
-			pivot_right();
-			motorspeed(speed,speed);
+			// if circle button only being press, pivot right
+			else if(SKPS_PRESSED(s_ps2, p_circle))
+			{
+				//pivot right
+				pivot_right();
+				motorspeed(speed,speed);
 			
-		}	
+			}	
 			
-		//analog control for mobility
-		// if left joystick being push up	
-		else if(up_v > 10)
-		{
-		 	// if left joystick being push to left too
-			if(left_v > 10)
+			//analog control for mobility
+			// if left joystick being push up	
+			else if(up_v > 10)
 			{
-				//turn left	
-				forward();
-				motorspeed(0,speed);	//turning left with stop at left motor									
+			 	// if left joystick being push to left too
+				if(left_v > 10)
+				{
+					//turn left	
+					forward();
+					motorspeed(0,speed);	//turning left with stop at left motor									
+				}
+				else if(right_v > 0)
+				{
+					//turn right
+					forward();
+					motorspeed(speed,0);	//turning right with stop at right motor				
+				}
+				else
+				{
+					//normal forward
+					forward();	// direction forward	
+					motorspeed(speed,speed);	// forward with both left and right speed same		
+				}			
+			
 			}
-			else if(right_v > 0)
+			//if left joystick being push down
+			else if(down_v > 0)
 			{
-				//turn right
-				forward();
-				motorspeed(speed,0);	//turning right with stop at right motor				
+				// if left joystick being push left too
+				if(left_v > 0)
+				{
+					// reverse towards left	
+					reverse();	
+					motorspeed(0,speed);	//reserve left with stop at left motor				
+				}
+				else if(right_v > 0)
+				{
+					// reverse towards right
+					reverse();
+					motorspeed(speed,0);	//reserve right with stop at right motor			
+				}
+				else
+				{
+				//normal reverse
+				reverse();	
+				motorspeed(speed,speed);	//reverse with normal, same speed on left and right motor								
+				}		
 			}
-			else
-			{
-				//normal forward
-				forward();	// direction forward	
-				motorspeed(speed,speed);	// forward with both left and right speed same		
-			}			
-			
-		}
-		//if left joystick being push down
-		else if(down_v > 0)
-		{
-			// if left joystick being push left too
-			if(left_v > 0)
+		
+			// if left up and down axis is not push, only left and right axis being push
+			else if(left_v > 0)
 			{
-				// reverse towards left	
-				reverse();	
-				motorspeed(0,speed);	//reserve left with stop at left motor				
+				//pivot left
+				pivot_left();
+				motorspeed(speed,speed);			
 			}
-			else if(right_v > 0)
+			// if right joystick being push to right only
+			else if(right_v>0)
 			{
-				// reverse towards right
-				reverse();
-				motorspeed(speed,0);	//reserve right with stop at right motor			
+				//pivot right
+				pivot_right();
+				motorspeed(speed,speed);				
 			}
+		
+			// if no joystick or button on top panel being pressed, stop the robot (no navigation)
 			else
 			{
-			//normal reverse
-			reverse();	
-			motorspeed(speed,speed);	//reverse with normal, same speed on left and right motor								
-			}		
-		}
-		
-		// if left up and down axis is not push, only left and right axis being push
-		else if(left_v > 0)
-		{
-			//pivot left
-			pivot_left();
-			motorspeed(speed,speed);			
-		}
-		// if right joystick being push to right only
-		else if(right_v>0)
-		{
-			//pivot right
-			pivot_right();
-			motorspeed(speed,speed);				
-		}
+				stop();		// if left analog joystick is not pushed, both left and right motor will brake	
+			}	
+			PT_YIELD(pt_drive);	// next PS2 state from task_ps2
+		}//while, until SELECT is pressed
 		
-		// if no joystick or button on top panel being pressed, stop the robot (no navigation)
-		else
-		{
-			stop();		// if left analog joystick is not pushed, both left and right motor will brake	
-		}	
-	}//while(ps(p_select) == 1)
+		b_driving = 0;
+		stop();
+		uc_beeps = 2;
+		PT_DELAY(pt_drive, ui_drive_wait, 100);
+	}
+	PT_END(pt_drive);
+}
+
+/*******************************************************************************
+* PRIVATE FUNCTION: task_display
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Task, show the speed set with the right joystick on the first line while
+* the robot is driven.
+*
+*******************************************************************************/
+void task_display(void)
+{
+	if (b_driving == 0) return;
 	
-	while(uc_skps(p_select) == 0) continue; //wait for p select to be release
-	beep(2);
-	delay_ms(100);
+	lcd_home();
+	lcd_putstr("SPD ");
+	lcd_bcd(4, speed);
+}
+
+/*******************************************************************************
+* PRIVATE FUNCTION: task_beep
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Task, beep uc_beeps times without holding up the other tasks.
+*
+*******************************************************************************/
+void task_beep(void)
+{
+	PT_BEGIN(pt_beep);
+	while (1) {
+		PT_WAIT_UNTIL(pt_beep, uc_beeps != 0);
+		BUZZER = 1;
+		PT_DELAY(pt_beep, ui_beep_wait, 50);
+		BUZZER = 0;
+		PT_DELAY(pt_beep, ui_beep_wait, 50);
+		uc_beeps--;
+	}
+	PT_END(pt_beep);
 }
 
 // ==================== brushless motor control =======================================
@@ -697,13 +764,13 @@ void forward(void)
 	run();
 	if(GEAR == 1)
 	{
-	DIRL = 1;	//motor at left(PORT1) and right(PORT2) 
-	DIRR = 0;	//Robot will forward depend on gear type
+	b_dirl = 1;	//motor at left(PORT1) and right(PORT2) 
+	b_dirr = 0;	//Robot will forward depend on gear type
 	}
 	else
 	{
-	DIRL = 0;	//motor at left(PORT1) and right(PORT2) 
-	DIRR = 1;	//Robot will forward depend on gear type
+	b_dirl = 0;	//motor at left(PORT1) and right(PORT2) 
+	b_dirr = 1;	//Robot will forward depend on gear type
 	}
 }
 
@@ -712,13 +779,13 @@ void reverse(void)
 	run();
 	if(GEAR == 1)
 	{
-	DIRL = 0;	//motor at left(PORT1) and right(PORT2) 
-	DIRR = 1;	//Robot will reverse depend on gear type
+	b_dirl = 0;	//motor at left(PORT1) and right(PORT2) 
+	b_dirr = 1;	//Robot will reverse depend on gear type
 	}
 	else 
 	{
-	DIRL = 1;	//motor at left(PORT1) and right(PORT2) 
-	DIRR = 0;	//Robot will reverse depend on gear type
+	b_dirl = 1;	//motor at left(PORT1) and right(PORT2) 
+	b_dirr = 0;	//Robot will reverse depend on gear type
 	}	
 }
 
@@ -727,13 +794,13 @@ void pivot_left(void)
 	run();
 	if(GEAR == 1)
 	{
-	DIRL = 0;	//motor at left(PORT1) and right(PORT2) 
-	DIRR = 0;	//Robot will turn left depend on gear type		
+	b_dirl = 0;	//motor at left(PORT1) and right(PORT2) 
+	b_dirr = 0;	//Robot will turn left depend on gear type		
 	}
 	else
 	{
-	DIRL = 1;	//motor at left(PORT1) and right(PORT2) 
-	DIRR = 1;	//Robot will turn left depend on gear type		
+	b_dirl = 1;	//motor at left(PORT1) and right(PORT2) 
+	b_dirr = 1;	//Robot will turn left depend on gear type		
 	}	
 }
 
@@ -742,32 +809,37 @@ void pivot_right(void)
 	run();
 	if(GEAR == 1)
 	{
-	DIRL = 1;	//motor at left(PORT1) and right(PORT2) 
-	DIRR = 1;	//Robot will turn right depend on gear type	
+	b_dirl = 1;	//motor at left(PORT1) and right(PORT2) 
+	b_dirr = 1;	//Robot will turn right depend on gear type	
 	}
 	else
 	{	
-	DIRL = 0;	//motor at left(PORT1) and right(PORT2) 
-	DIRR = 0;	//Robot will turn right depend on gear type	
+	b_dirl = 0;	//motor at left(PORT1) and right(PORT2) 
+	b_dirr = 0;	//Robot will turn right depend on gear type	
 	}	
 }
 void stop(void)
 {
+	ramp_stop();	//slow down both motors
+	if (uc_ramp_busy() == 1) return;	//brake once both are down to zero
+	
+	if ((RUNL == 1) && (RUNR == 1)) return;	//already braked
+	
 	RUNL = 1;	//motor at left(PORT1) and right (PORT2)
 	RUNR = 1; 	//will brake
-	BL_R = 0;	//after stop, reset the brushless
-	__delay_ms(5);	// this reset can only be used if internal crystal is used
-	BL_R = 1;		// and JP27 (BL-R) is connected
-	__delay_ms(10);	
+	blreset_start();	//after stop, reset the brushless, this reset can only be used
+						//if internal crystal is used and JP27 (BL-R) is connected
 }
 void run(void)
 {
+	if (uc_blreset_busy() == 1) return;	//stay braked until the drivers are reset, the next call runs
+	
 	RUNL = 0;	//motor at left(PORT1) and right (PORT2)
 	RUNR = 0; 	//will run	
 }
 void motorspeed(unsigned int m_left, unsigned int m_right)
 {	
-	left_speed(m_left);	//left motor speed
-	right_speed(m_right);	// right motor speed
+	// left motor at PORT1, right motor at PORT2, ramp together, through zero on a direction change
+	ramp_set((b_dirl == 1) ? (int)m_left : -(int)m_left, (b_dirr == 1) ? (int)m_right : -(int)m_right);
 }
 
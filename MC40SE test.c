@@ -12,6 +12,12 @@
 #include "pwm.h"
 #include "lcd.h"
 #include "skps.h"
+#include "timer0.h"
+#include "event.h"
+#include "bus.h"
+#include "relay.h"
+#include "velocity.h"
+#include "pid.h"
 
 /*******************************************************************************
 * DEVICE CONFIGURATION WORDS FOR PIC16F887                                     *
@@ -60,12 +66,20 @@
 #define	CW		0
 #define	CCW		1
 
+// Brushless port and encoder jumper of the PID wheel speed loop.
+#if PID_PWM_CHANNEL == 2
+#define	PID_PORT		PORT2
+#define	PID_JUMPER_MSG	"Jumper\nRC0=ENC2"
+#else
+#define	PID_PORT		PORT1
+#define	PID_JUMPER_MSG	"Jumper\nRC0=ENC1"
+#endif
+
 
 /*******************************************************************************
 * PRIVATE FUNCTION PROTOTYPES                                                  *
 *******************************************************************************/
 
-void delay_ms(unsigned int ui_value);
 void beep(unsigned char uc_count);
 void mc40se_init(void);
 void test_switch(void);
@@ -79,13 +93,11 @@ void test_relay(void);
 void test_ex_md(void);
 void test_uart(void);
 void test_skps(void);
+void test_pid(void);
 
 
 void brushless(unsigned char uc_port_number, unsigned char uc_motor_status, unsigned char uc_motor_dir, unsigned int ui_speed);
 void brush(unsigned char uc_port_number, unsigned char uc_motor_status, unsigned char uc_motor_dir, unsigned int ui_speed);
-void relay_on(unsigned char uc_relay_number);
-void relay_off(unsigned char uc_relay_number);
-void relay_off_all(void);
 
 
 /*******************************************************************************
@@ -101,15 +113,23 @@ char string_passed[] = "Passed!";
 int main(void)
 {
 	unsigned char test_number = 1;
+	unsigned char uc_run;
+	EVENT s_event;
 	
 	// Initialize PIC16F887 to correct Input/Output based on MC40SE on board interface
 	mc40se_init();	
 	
+	// Initialize 1ms system tick, delay_ms runs on it.
+	timer0_init();
+	
 	// Initialize ADC.
 	adc_init();
 	
+	// Initialize the PORTD bus, shared by the LCD and the relays.
+	bus_init();
+	
 	// off all relays
-	relay_off_all();
+	relay_init();
 	
 	// Initialize UART.
 	uart_init();
@@ -120,6 +140,9 @@ int main(void)
 	// Initialize PWM.
 	timer1_init();
 	
+	// Initialize the switch events, use the 1ms system tick.
+	event_init();
+	
 	// Initialize the LCD.
 	lcd_init();		
 	
@@ -135,9 +158,21 @@ int main(void)
 		
 	// Need to make sure the push button is useable before perform other test.
 	test_switch();
+	event_flush();		// test_switch read the switches directly
 		
 	while (1) 
 		{
+		// Take the next switch event, release of SW2 run the selected test.
+		uc_run = 0;
+		if (uc_event_get(&s_event) == 0)
+		{
+			s_event.uc_id = 0xFF;	// no event
+		}
+		else if ((s_event.uc_id == EVENT_SW2) && (s_event.uc_type == EVENT_RELEASE))
+		{
+			uc_run = 1;
+		}
+		
 		lcd_2ndline();
 		lcd_putstr("1+,2=Run");
 	
@@ -148,8 +183,8 @@ int main(void)
 			{
 			case 1:
 				lcd_putstr("1:All   ");
-				if (SW2 == 0) 			// if SW2 is press
-				{	while (SW2 == 0);	// waiting for SW2 to be let go
+				if (uc_run == 1) 		// if SW2 is press and let go
+				{
 					test_led();			// test LED or Buzzer
 					test_di();			// test digital input
 					test_adc();			// test analog input
@@ -160,109 +195,113 @@ int main(void)
 					test_ex_md();		// test external MD, which should be connected at MD3 or MD4 ports
 					test_uart();		// tesr UART connection to computer is needed, through UC00A					
 					test_skps();		// test SKPS, SKPS, Wired PS2 or wireless PS2 is needed
+					test_pid();			// test wheel speed loop, brushless motor with encoder
 				}	
 				break;
 				
 			case 2:
 				lcd_putstr("2:LED+BZ");
-				if (SW2 == 0) 
+				if (uc_run == 1) 
 				{
-					while (SW2 == 0);
 					test_led();
 				}	
 				break;
 				
 			case 3:
 				lcd_putstr("3:Dig In");
-				if (SW2 == 0) 
+				if (uc_run == 1) 
 				{
-					while (SW2 == 0);
 					test_di();
 				}	
 				break;
 				
 			case 4:
 				lcd_putstr("4:ADC   ");
-				if (SW2 == 0) 
+				if (uc_run == 1) 
 				{
-					while (SW2 == 0);
 					test_adc();
 				}	
 				break;
 				
 			case 5:
 				lcd_putstr("5:B-less");
-				if (SW2 == 0) 
+				if (uc_run == 1) 
 				{
-					while (SW2 == 0);
 					test_brushless();
 				}	
 				break;
 			
 			case 6:
 				lcd_putstr("6:BrushM");
-				if (SW2 == 0) 
+				if (uc_run == 1) 
 				{
-					while (SW2 == 0);
 					test_brush();
 				}	
 				break;
 				
 			case 7:
 				lcd_putstr("7:Relays");
-				if (SW2 == 0) 
+				if (uc_run == 1) 
 				{
-					while (SW2 == 0);
 					test_relay();
 				}	
 				break;
 			
 			case 8:
 				lcd_putstr("8:Ex_MD ");
-				if (SW2 == 0) 
+				if (uc_run == 1) 
 				{
-					while (SW2 == 0);
 					test_ex_md();
 				}	
 				break;
 					
 			case 9:
 				lcd_putstr("9:ENC   ");
-				if (SW2 == 0) 
+				if (uc_run == 1) 
 				{
-					while (SW2 == 0);
 					test_encoder();
 				}	
 				break;
 			
 			case 10:		
 				lcd_putstr("10:UART ");
-				if (SW2 == 0) 
+				if (uc_run == 1) 
 				{
-					while (SW2 == 0);
 					test_uart();
 				}	
 				break;
 				
 			case 11:				
 				lcd_putstr("11:SKPS ");
-				if (SW2 == 0) 
+				if (uc_run == 1) 
 				{
-					while (SW2 == 0);
 					test_skps();
 				}	
 				break;	
+				
+			case 12:				
+				lcd_putstr("12:PID  ");
+				if (uc_run == 1) 
+				{
+					test_pid();
+				}	
+				break;	
 			
 		}//switch (test_number) 		
 		
+		// The tests read the switches directly, drop what they left in the queue.
+		if (uc_run == 1)
+		{
+			event_flush();
+		}
+		
 		// If SW1 is pressed...
-		if (SW1 == 0) 
+		if ((s_event.uc_id == EVENT_SW1) && (s_event.uc_type == EVENT_PRESS)) 
 		{
-			if (++test_number > 11) 
+			if (++test_number > 12) 
 			{
 				test_number = 1;
 			}				
-			while (SW1 == 0);
 			beep(1);
 		}		
 	
@@ -272,27 +311,6 @@ int main(void)
 
 
 
-/*******************************************************************************
-* PRIVATE FUNCTION: delay_ms
-*
-* PARAMETERS:
-* ~ ui_value	- The period for the delay in miliseconds.
-*
-* RETURN:
-* ~ void
-*
-* DESCRIPTIONS:
-* Delay in miliseconds.
-*
-*******************************************************************************/
-void delay_ms(unsigned int ui_value)
-{
-	while (ui_value-- > 0) {
-		__delay_ms(1);
-	}	
-}
-
-
 /*******************************************************************************
 * PRIVATE FUNCTION: beep
 *
@@ -562,33 +580,25 @@ void test_di(void)
 void test_adc(void)
 {
 	
-	unsigned char uc_d1 = 0, uc_d3 = 0, uc_d4 = 0;	
-	unsigned int ui_adc = 0, uc_d2 = 0;
-	unsigned char i = 0;
+	// AN0 only, average of every 8 samples
+	const ADC_CHANNEL cs_channel[] = {{0, ADC_TACQ_US(10000), 0, 3, 0}};
 	// Display the messages.
 	lcd_clear_msg("Testing\nADC");
 	delay_ms(1000);	
 	
 	lcd_clear_msg("ADC:\nSW1 exit");	
 	
-	ADON= 1; 	//Activate ADC module
+	uc_adc_scan_start(cs_channel, 1);	// convert AN0 in the background
 	while (SW1 == 1)	// Loop until SW1 is pressed.
 	 {	
-		ui_adc = 0;	
-		for(i = 0; i < 10; i++)		// read 10 times from ADC module and take the average value
-		{
-		ui_adc = ui_adc + ui_adc_read();	// read adc value from channel 0
-		}
-		ui_adc = ui_adc/10;		
-		
 		lcd_goto(0x04);	//goto character after ADC:
-		lcd_bcd(4, ui_adc);	
+		lcd_bcd(4, ui_adc_filtered(0));	// latest average of channel 0
 	}//while (SW1 == 1)	
 	
 	// Waiting for user to release SW1.
 	while (SW1 == 0);
 	
-	ADON = 0;	// Deactivate ADC module
+	adc_scan_stop();	// Deactivate ADC module
 	
 	lcd_clear_msg(string_passed);
 	beep(2);		// done
@@ -1267,6 +1277,102 @@ void test_skps(void)
 	delay_ms(500);
 }
 /*******************************************************************************
+* PRIVATE FUNCTION: test_pid
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Test the PID wheel speed loop on the brushless motor with the encoder. SW2
+* steps the target speed, SW1 ends the test.
+*
+*******************************************************************************/
+void test_pid(void)
+{
+	// target speeds in counts/s, the feed-forward in system.h is for 3000 counts/s
+	const unsigned int cs_target[] = {500, 1000, 2000};
+	unsigned char uc_target = 0;
+	unsigned char uc_exit = 0;
+	unsigned char i = 0;
+	EVENT s_event;
+	
+	// Display the messages.
+	lcd_clear_msg("Test\nPID");
+	delay_ms(1000);
+	
+	// Waiting for user to press SW1.
+	while (SW1 == 1) {
+		lcd_clear_msg("Connect \nB-less M");
+		for (i = 0; i < 200; i++) {
+			if (SW1 == 0) {
+				break;
+			}	
+			delay_ms(10);
+		}
+		
+		lcd_clear_msg(PID_JUMPER_MSG);
+		for (i = 0; i < 200; i++) {
+			if (SW1 == 0) {
+				break;
+			}	
+			delay_ms(10);
+		}
+		
+		lcd_clear_msg("SW1\nto test");
+		for (i = 0; i < 200; i++) {
+			if (SW1 == 0) {
+				break;
+			}	
+			delay_ms(10);
+		}
+	}
+	
+	// Waiting for user to release SW1.
+	while (SW1 == 0);
+	event_flush();		// the switches were read directly
+	
+	// Close the loop, T: target and V: measured speed in counts/s.
+	lcd_clear_msg("T:\nV:");
+	set_encoder(0);
+	velocity_init();
+	pid_init();
+	brushless(PID_PORT, RUN, CW, 0);
+	pid_set_speed(cs_target[uc_target]);
+	
+	while (uc_exit == 0) {
+		// the speed first, the loop takes the latest speed
+		velocity_task();
+		pid_task();
+		
+		if ((uc_event_get(&s_event) == 1) && (s_event.uc_type == EVENT_PRESS)) {
+			if (s_event.uc_id == EVENT_SW1) {
+				uc_exit = 1;
+			}
+			else if (s_event.uc_id == EVENT_SW2) {
+				if (++uc_target >= (sizeof(cs_target) / sizeof(cs_target[0]))) uc_target = 0;
+				pid_set_speed(cs_target[uc_target]);
+			}
+		}
+		
+		lcd_goto(0x02);
+		lcd_bcd(5, cs_target[uc_target]);
+		lcd_goto(0x42);
+		lcd_bcd(5, (unsigned int)(ul_velocity() / VELOCITY_ONE));
+	}
+	
+	// Stop the loop and the motor.
+	pid_stop();
+	brushless(PID_PORT, BRAKE, CW, 0);
+	
+	// Display the messages.
+	lcd_clear_msg(string_passed);
+	beep(2);
+	delay_ms(500);
+}
+/*******************************************************************************
 * PRIVATE FUNCTION: brushless
 *
 * PARAMETERS:
@@ -1391,66 +1497,3 @@ void brush(unsigned char uc_port_number, unsigned char uc_motor_status, unsigned
 		set_pwm2(ui_speed);
 	}	
 }	
-/*******************************************************************************
-* PRIVATE FUNCTION: relay_on
-*
-* PARAMETERS:
-* ~ unsigned char uc_relay_number - relay that needed to be activate, from 1-8
-*
-* RETURN:
-* ~ void
-*
-* DESCRIPTIONS:
-* activate relay.
-*
-*******************************************************************************/
-void relay_on(unsigned char uc_relay_number)
-{
-	LATCH = 0;	// hold the state of latch
-	PORTD = PORTD | (0b00000001<< (uc_relay_number - 1));
-	LATCH = 1;	// transfer the new output to relay
-	delay_ms(1);
-	LATCH = 0;	// hold the output of latch
-}	
-/*******************************************************************************
-* PRIVATE FUNCTION: relay_off
-*
-* PARAMETERS:
-* ~ unsigned char uc_relay_number - relay that needed to be deactivate, from 1-8
-*
-* RETURN:
-* ~ void
-*
-* DESCRIPTIONS:
-* Deactivate relay
-*
-*******************************************************************************/
-void relay_off(unsigned char uc_relay_number)
-{
-	LATCH = 0;	// hold the state of latch
-	PORTD = PORTD & (~(0b00000001<< (uc_relay_number -1)));
-	LATCH = 1;	// transfer the new output to relay
-	delay_ms(1);
-	LATCH = 0;	// hold the output of latch
-}	
-/*******************************************************************************
-* PRIVATE FUNCTION: relay_off_all
-*
-* PARAMETERS:
-* ~ void
-*
-* RETURN:
-* ~ void
-*
-* DESCRIPTIONS:
-* deactivate all relays.
-*
-*******************************************************************************/
-void relay_off_all(void)
-{
-	LATCH = 0;	// hold the output of latch
-	PORTD = 0; 	// Off all relays
-	LATCH = 1;	// enable latch to read input and transfer to output
-	delay_ms(5);
-	LATCH = 0;	// hold the output of latch
-}
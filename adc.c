@@ -12,6 +12,124 @@
 
 
 
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+// Position of the channel select bits CHS in ADCON0.
+#if defined (_16F887)
+#define CHS_SHIFT			2			// CHS3:CHS0 = bit 5 - 2
+#define CHS_MASK			0b00111100
+#define ADC_LAST_CHANNEL	13
+#elif defined (_16F877A)
+#define CHS_SHIFT			3			// CHS2:CHS0 = bit 5 - 3
+#define CHS_MASK			0b00111000
+#define ADC_LAST_CHANNEL	4
+#endif
+
+// A/D conversion clock, the lowest divider giving TAD of at least 1.6us.
+#if defined (_16F887)
+#if _XTAL_FREQ <= 1250000
+#define ADC_CLOCK_DIV		2			// ADCS1:ADCS0 = 00
+#define ADC_ADCS			0b00
+#elif _XTAL_FREQ <= 5000000
+#define ADC_CLOCK_DIV		8			// ADCS1:ADCS0 = 01
+#define ADC_ADCS			0b01
+#else
+#define ADC_CLOCK_DIV		32			// ADCS1:ADCS0 = 10
+#define ADC_ADCS			0b10
+#endif
+#elif defined (_16F877A)
+#if _XTAL_FREQ <= 1250000
+#define ADC_CLOCK_DIV		2			// ADCS2:ADCS1:ADCS0 = 000
+#define ADC_ADCS			0b000
+#elif _XTAL_FREQ <= 2500000
+#define ADC_CLOCK_DIV		4			// ADCS2:ADCS1:ADCS0 = 100
+#define ADC_ADCS			0b100
+#elif _XTAL_FREQ <= 5000000
+#define ADC_CLOCK_DIV		8			// ADCS2:ADCS1:ADCS0 = 001
+#define ADC_ADCS			0b001
+#elif _XTAL_FREQ <= 10000000
+#define ADC_CLOCK_DIV		16			// ADCS2:ADCS1:ADCS0 = 101
+#define ADC_ADCS			0b101
+#else
+#define ADC_CLOCK_DIV		32			// ADCS2:ADCS1:ADCS0 = 010
+#define ADC_ADCS			0b010
+#endif
+#endif
+
+// Wait between two conversions of the same channel, 2 TAD.
+#define ADC_2TAD_US			((2UL * ADC_CLOCK_DIV * 1000000UL + _XTAL_FREQ - 1) / _XTAL_FREQ)
+
+// Acquisition wait loop, each pass takes ADC_WAIT_STEP_US. The loop itself
+// takes about 4 instruction cycles, _delay makes up the rest.
+#define ADC_CYCLES_PER_US	(_XTAL_FREQ / 4000000UL)
+#define ADC_WAIT_STEP_US	(4 / ADC_CYCLES_PER_US + 1)
+#define ADC_WAIT_CYCLES		(ADC_CYCLES_PER_US * ADC_WAIT_STEP_US - 4)
+#define ADC_WAIT_LOOPS(us)	(((us) + ADC_WAIT_STEP_US - 1) / ADC_WAIT_STEP_US)
+
+// No channel selected yet.
+#define ADC_NO_CHANNEL		0xFF
+
+// Select the channel, the holding capacitor starts to charge.
+#define ADC_SELECT(ch)		ADCON0 = (ADCON0 & ~CHS_MASK) | ((ch) << CHS_SHIFT)
+
+// Start the conversion.
+#if defined (HITECH_V9_80)	//if Hi-Tech V9.80 compiler is used
+#define ADC_START()			ADGO = 1
+#elif defined (HITECH_V9_82)	//if Hi-Tech V9.82 compiler is used
+#define ADC_START()			GO_DONE = 1
+#endif
+
+// Channels of MC40SE that are outputs, they can not be analog.
+// AN5 = RE0 (RUN1), AN6 = RE1 (DIR1), AN7 = RE2 (LCD_E)
+#define ADC_OUTPUT_CHANNELS	0b11100000
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+// Scan list.
+unsigned char uc_scan_channel[ADC_MAX_CHANNELS];
+unsigned char uc_scan_loops[ADC_MAX_CHANNELS];	// acquisition wait before the conversion
+unsigned char uc_scan_count = 0;
+volatile unsigned char uc_scan_index = 0;		// channel being converted
+volatile unsigned char b_scan_running = 0;		// 1 = adc_tick starts the scans
+volatile unsigned char b_scan_busy = 0;			// 1 = a scan is being converted
+unsigned char uc_scan_timer = 0;				// ms to the next scan
+
+// Double buffered results, the ISR fills the back buffer and swaps it with the
+// front buffer when the scan is finished.
+unsigned int ui_scan_result[2][ADC_MAX_CHANNELS];
+volatile unsigned char uc_scan_front = 0;
+
+// Filter settings and state of each channel in the scan list.
+unsigned char uc_oversample_bits[ADC_MAX_CHANNELS];
+unsigned char uc_boxcar_bits[ADC_MAX_CHANNELS];
+unsigned char uc_iir_shift[ADC_MAX_CHANNELS];
+unsigned char uc_oversample_count[ADC_MAX_CHANNELS];	// samples left for the sum
+unsigned char uc_boxcar_count[ADC_MAX_CHANNELS];		// values left for the average
+unsigned int ui_oversample_sum[ADC_MAX_CHANNELS];
+unsigned int ui_boxcar_sum[ADC_MAX_CHANNELS];
+unsigned int ui_iir_sum[ADC_MAX_CHANNELS];				// y x 2^shift
+unsigned int ui_filtered[ADC_MAX_CHANNELS];
+
+// Channel of the last conversion.
+unsigned char uc_adc_channel = ADC_NO_CHANNEL;
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION PROTOTYPES                                                  *
+*******************************************************************************/
+
+void adc_convert(void);
+void adc_filter(unsigned char uc_index, unsigned int ui_value);
+
+
+
 /*******************************************************************************
 * PUBLIC FUNCTION: adc_init
 *
@@ -28,9 +146,9 @@
 void adc_init(void)
 {
 #if defined(_16F887)//if this file is compile for PIC16F887
-	// A/D Conversion Clock = FOSC/32.
-	ADCS1 = 1;
-	ADCS0 = 0;
+	// A/D Conversion Clock = FOSC/ADC_CLOCK_DIV.
+	ADCS1 = (ADC_ADCS >> 1) & 1;
+	ADCS0 = ADC_ADCS & 1;
 	
 	// Set AN0 as analog input only, the rest is digital I/O.
 	ANS0 = 1;	// AN0 is analog input
@@ -60,10 +178,10 @@ void adc_init(void)
 	// Turn OFF ADC by default.
 	ADON = 0;
 #elif defined (_16F877A)	//if this file is compile for PIC16F877A
-	// A/D Conversion Clock = FOSC/32.
-	ADCS2 = 0;
-	ADCS1 = 1;
-	ADCS0 = 0;
+	// A/D Conversion Clock = FOSC/ADC_CLOCK_DIV.
+	ADCS2 = (ADC_ADCS >> 2) & 1;
+	ADCS1 = (ADC_ADCS >> 1) & 1;
+	ADCS0 = ADC_ADCS & 1;
 	
 	// Set AN0 as analog input only, the rest is digital I/O.
 	PCFG3 = 1;	
@@ -91,22 +209,33 @@ void adc_init(void)
 * ~ The ADC result in 16 bit
 *
 * DESCRIPTIONS:
-* Convert and read the result of the ADC at channel 0.
+* Convert and read the result of the ADC at channel 0. A running scan is
+* paused, after the scan in progress is finished, and goes on after.
 *
 *******************************************************************************/
-extern unsigned int ui_adc_read(void)
+unsigned int ui_adc_read(void)
 {
 	unsigned int temp = 0;
-	// Select the ADC channel.
-#if defined (_16F887)	// if this file is compile for PIC16F887
-	CHS3 = 0;	//select channel 0
-#endif
-	CHS2 = 0;
-	CHS1 = 0;
-	CHS0 = 0;
+	unsigned char b_paused = b_scan_running;
+	
+	// The scan uses the same ADC, stop adc_tick starting a new one and let
+	// the one in progress finish.
+	if (b_paused == 1) {
+		b_scan_running = 0;
+		while (b_scan_busy == 1) continue;
+		ADIE = 0;
+	}
 	
-	// Delay 5mS to fully charge the holding capacitor in the ADC module.
-	__delay_ms(5);
+	// Select the ADC channel and let the holding capacitor charge. If it is
+	// already on channel 0, only wait the 2 TAD needed between conversions.
+	if (uc_adc_channel != 0) {
+		uc_adc_channel = 0;
+		ADC_SELECT(0);
+		__delay_us(ADC_TACQ_US(ADC_SOURCE_OHMS));
+	}
+	else {
+		__delay_us(ADC_2TAD_US);
+	}
 	
 	// Start the conversion and wait for it to complete.
 	#if defined (HITECH_V9_80)	//if Hi-Tech V9.80 compiler is used
@@ -117,8 +246,374 @@ extern unsigned int ui_adc_read(void)
 	while (GO_DONE == 1);		//await for ADC to complete the conversion
 	#endif	
 	
-	// Return the ADC result.
+	// Read the ADC result.
 	temp = ADRESH << 8;
 	temp = temp + ADRESL;
+	
+	// Give the ADC back to the scan, it goes on from the next adc_tick.
+	if (b_paused == 1) {
+		ADIF = 0;
+		ADIE = 1;
+		b_scan_running = 1;
+	}
 	return temp;
 }	
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_adc_scan_start
+*
+* PARAMETERS:
+* ~ cs_channels		- List of analog channels to scan, with their acquisition
+*					  time and filter.
+* ~ uc_count		- Number of channels in the list, 1 to ADC_MAX_CHANNELS.
+*
+* RETURN:
+* ~ 1 if the scan is started, 0 if the list can not be used.
+*
+* DESCRIPTIONS:
+* Make the listed pins analog inputs and convert them one after another in the
+* background, a scan every ADC_SAMPLE_PERIOD_MS.
+*
+*******************************************************************************/
+unsigned char uc_adc_scan_start(const ADC_CHANNEL* cs_channels, unsigned char uc_count)
+{
+	unsigned char uc_index;
+	unsigned char uc_channel;
+	unsigned char uc_bits;
+	unsigned char uc_low_mask = 0;		// analog channels AN0 - AN7
+#if defined (_16F887)
+	unsigned char uc_high_mask = 0;		// analog channels AN8 - AN13
+#endif
+	
+	if ((uc_count == 0) || (uc_count > ADC_MAX_CHANNELS)) return 0;
+	
+	for (uc_index = 0; uc_index < uc_count; uc_index++) {
+		// The filter values must fit in 16 bits.
+		if (cs_channels[uc_index].uc_oversample_bits > 3) return 0;
+		uc_bits = 10 + cs_channels[uc_index].uc_oversample_bits;
+		if (uc_bits + cs_channels[uc_index].uc_boxcar_bits > 16) return 0;
+		if (uc_bits + cs_channels[uc_index].uc_iir_shift > 16) return 0;
+		
+		uc_channel = cs_channels[uc_index].uc_channel;
+		if (uc_channel > ADC_LAST_CHANNEL) return 0;
+		
+#if defined (_16F887)
+		if (uc_channel >= 8) {
+			uc_high_mask |= 1 << (uc_channel - 8);
+			continue;
+		}
+#endif
+		uc_low_mask |= 1 << uc_channel;
+	}
+	if (uc_low_mask & ADC_OUTPUT_CHANNELS) return 0;
+	
+	adc_scan_stop();
+	
+	for (uc_index = 0; uc_index < uc_count; uc_index++) {
+		uc_scan_channel[uc_index] = cs_channels[uc_index].uc_channel;
+		uc_scan_loops[uc_index] = ADC_WAIT_LOOPS(cs_channels[uc_index].uc_acquisition_us);
+		ui_scan_result[0][uc_index] = ADC_NO_RESULT;
+		ui_scan_result[1][uc_index] = ADC_NO_RESULT;
+		
+		uc_oversample_bits[uc_index] = cs_channels[uc_index].uc_oversample_bits;
+		uc_boxcar_bits[uc_index] = cs_channels[uc_index].uc_boxcar_bits;
+		uc_iir_shift[uc_index] = cs_channels[uc_index].uc_iir_shift;
+		uc_oversample_count[uc_index] = 1 << (uc_oversample_bits[uc_index] << 1);
+		uc_boxcar_count[uc_index] = 1 << uc_boxcar_bits[uc_index];
+		ui_oversample_sum[uc_index] = 0;
+		ui_boxcar_sum[uc_index] = 0;
+		ui_filtered[uc_index] = ADC_NO_RESULT;
+	}
+	uc_scan_count = uc_count;
+	uc_scan_index = 0;
+	uc_scan_front = 0;
+	
+	// Make the channels analog, AN0 stays analog as set by adc_init.
+#if defined (_16F887)
+	ANSEL = uc_low_mask | 0b00000001;
+	ANSELH = uc_high_mask;
+#elif defined (_16F877A)
+	// Use the setting with the fewest analog pins that has all the channels.
+	if ((uc_low_mask & 0b11111110) == 0) {
+		PCFG3 = 1; PCFG2 = 1; PCFG1 = 1; PCFG0 = 0;	// AN0
+	}
+	else if ((uc_low_mask & 0b11110100) == 0) {
+		PCFG3 = 0; PCFG2 = 1; PCFG1 = 0; PCFG0 = 0;	// AN0, AN1, AN3
+	}
+	else {
+		PCFG3 = 0; PCFG2 = 0; PCFG1 = 1; PCFG0 = 0;	// AN0 - AN4
+	}
+#endif
+	
+	// adc_tick starts the first scan.
+	ADON = 1;
+	uc_adc_channel = ADC_NO_CHANNEL;
+	ADIF = 0;
+	ADIE = 1;
+	PEIE = 1;
+	GIE = 0;
+	b_scan_busy = 0;
+	uc_scan_timer = ADC_SAMPLE_PERIOD_MS;
+	b_scan_running = 1;
+	GIE = 1;
+	return 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: adc_scan_stop
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Stop the scan and turn off the ADC. The last results can still be read.
+*
+*******************************************************************************/
+void adc_scan_stop(void)
+{
+	b_scan_running = 0;
+	ADIE = 0;
+	ADON = 0;
+	ADIF = 0;
+	b_scan_busy = 0;
+	uc_adc_channel = ADC_NO_CHANNEL;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_adc_get
+*
+* PARAMETERS:
+* ~ uc_channel	- Analog channel, one of the channels in the scan list.
+*
+* RETURN:
+* ~ The latest result of the channel, or ADC_NO_RESULT if the channel is not
+*   scanned or no scan has finished yet.
+*
+* DESCRIPTIONS:
+* Read the result of a channel from the last finished scan. This function does
+* not block.
+*
+*******************************************************************************/
+unsigned int ui_adc_get(unsigned char uc_channel)
+{
+	unsigned char uc_index;
+	unsigned int ui_result;
+	
+	for (uc_index = 0; uc_index < uc_scan_count; uc_index++) {
+		if (uc_scan_channel[uc_index] == uc_channel) {
+			GIE = 0;	// the buffers may be swapped in the middle of the read
+			ui_result = ui_scan_result[uc_scan_front][uc_index];
+			GIE = 1;
+			return ui_result;
+		}
+	}
+	return ADC_NO_RESULT;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: adc_get_scan
+*
+* PARAMETERS:
+* ~ pui_results	- Where to store the results, one for each channel in the
+*				  scan list, in the same order.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Copy the results of all channels from the last finished scan, so they are
+* all from the same scan.
+*
+*******************************************************************************/
+void adc_get_scan(unsigned int* pui_results)
+{
+	unsigned char uc_index;
+	
+	GIE = 0;
+	for (uc_index = 0; uc_index < uc_scan_count; uc_index++) {
+		pui_results[uc_index] = ui_scan_result[uc_scan_front][uc_index];
+	}
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_adc_filtered
+*
+* PARAMETERS:
+* ~ uc_channel	- Analog channel, one of the channels in the scan list.
+*
+* RETURN:
+* ~ The latest output of the filter of the channel, or ADC_NO_RESULT if the
+*   channel is not scanned or the filter has no output yet.
+*
+* DESCRIPTIONS:
+* Read the filtered value of a channel. This function does not block.
+*
+*******************************************************************************/
+unsigned int ui_adc_filtered(unsigned char uc_channel)
+{
+	unsigned char uc_index;
+	unsigned int ui_result;
+	
+	for (uc_index = 0; uc_index < uc_scan_count; uc_index++) {
+		if (uc_scan_channel[uc_index] == uc_channel) {
+			GIE = 0;	// adc_isr may write it in the middle of the read
+			ui_result = ui_filtered[uc_index];
+			GIE = 1;
+			return ui_result;
+		}
+	}
+	return ADC_NO_RESULT;
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for ADC
+*
+* DESCRIPTIONS:
+* Store and filter the result of the finished conversion and start the next
+* channel of the scan.
+*
+*******************************************************************************/
+void adc_isr(void)
+{
+	unsigned char uc_index = uc_scan_index;
+	unsigned int ui_value;
+	
+	ADIF = 0;
+	
+	ui_value = ADRESH << 8;
+	ui_value = ui_value + ADRESL;
+	ui_scan_result[uc_scan_front ^ 1][uc_index] = ui_value;
+	
+	adc_filter(uc_index, ui_value);
+	
+	// All channels converted, the back buffer becomes the front buffer and the
+	// ADC waits for the next adc_tick.
+	if (++uc_scan_index >= uc_scan_count) {
+		uc_scan_index = 0;
+		uc_scan_front ^= 1;
+		b_scan_busy = 0;
+		return;
+	}
+	adc_convert();
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for ADC, 1ms tick
+*
+* DESCRIPTIONS:
+* Start a scan every ADC_SAMPLE_PERIOD_MS. If the last scan is not finished,
+* this one is skipped. Call after timer0_isr.
+*
+*******************************************************************************/
+void adc_tick(void)
+{
+	if (b_scan_running == 0) return;
+	if (--uc_scan_timer != 0) return;
+	uc_scan_timer = ADC_SAMPLE_PERIOD_MS;
+	
+	if (b_scan_busy == 1) return;
+	b_scan_busy = 1;
+	uc_scan_index = 0;
+	adc_convert();
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: adc_convert
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Start the conversion of channel uc_scan_index of the scan list. If the ADC is
+* on another channel, select it and wait for its acquisition time. Called from
+* the ISR only.
+*
+*******************************************************************************/
+void adc_convert(void)
+{
+	unsigned char uc_loop;
+	
+	if (uc_adc_channel != uc_scan_channel[uc_scan_index]) {
+		uc_adc_channel = uc_scan_channel[uc_scan_index];
+		ADC_SELECT(uc_adc_channel);
+		for (uc_loop = uc_scan_loops[uc_scan_index]; uc_loop != 0; uc_loop--) {
+			_delay(ADC_WAIT_CYCLES);
+		}
+	}
+	ADC_START();
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: adc_filter
+*
+* PARAMETERS:
+* ~ uc_index	- Index of the channel in the scan list.
+* ~ ui_value	- New result of the channel.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Pass the result through the oversample, boxcar and IIR stages of the channel.
+* A stage that is still collecting values stops the chain. Called from the ISR
+* only.
+*
+*******************************************************************************/
+void adc_filter(unsigned char uc_index, unsigned int ui_value)
+{
+	// Oversample and decimate, the sum of 4^n samples shifted by n has n more
+	// bits.
+	if (uc_oversample_bits[uc_index] != 0) {
+		ui_oversample_sum[uc_index] += ui_value;
+		if (--uc_oversample_count[uc_index] != 0) return;
+		uc_oversample_count[uc_index] = 1 << (uc_oversample_bits[uc_index] << 1);
+		ui_value = ui_oversample_sum[uc_index] >> uc_oversample_bits[uc_index];
+		ui_oversample_sum[uc_index] = 0;
+	}
+	
+	// Boxcar, the average of every 2^n values.
+	if (uc_boxcar_bits[uc_index] != 0) {
+		ui_boxcar_sum[uc_index] += ui_value;
+		if (--uc_boxcar_count[uc_index] != 0) return;
+		uc_boxcar_count[uc_index] = 1 << uc_boxcar_bits[uc_index];
+		ui_value = ui_boxcar_sum[uc_index] >> uc_boxcar_bits[uc_index];
+		ui_boxcar_sum[uc_index] = 0;
+	}
+	
+	// First order IIR, the sum holds y x 2^n and starts at the first value.
+	if (uc_iir_shift[uc_index] != 0) {
+		if (ui_filtered[uc_index] == ADC_NO_RESULT) {
+			ui_iir_sum[uc_index] = ui_value << uc_iir_shift[uc_index];
+		}
+		else {
+			ui_iir_sum[uc_index] += ui_value - (ui_iir_sum[uc_index] >> uc_iir_shift[uc_index]);
+		}
+		ui_value = ui_iir_sum[uc_index] >> uc_iir_shift[uc_index];
+	}
+	ui_filtered[uc_index] = ui_value;
+}
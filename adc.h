@@ -9,6 +9,33 @@
 #ifndef _ADC_H
 #define _ADC_H
 
+// Result of a channel that is not scanned or not yet converted.
+#define ADC_NO_RESULT		0xFFFF
+
+// Holding capacitor of the ADC.
+#if defined (_16F887)
+#define ADC_CHOLD_PF		10
+#elif defined (_16F877A)
+#define ADC_CHOLD_PF		120
+#endif
+
+// Acquisition time in us for a source impedance in ohm, from the datasheet:
+// TACQ = amplifier settling 2us + temperature coefficient 1.25us (at 50C)
+//      + CHOLD x (RIC 1k + RSS 7k + source) x ln(2047)
+// For 10k ohm this is 5us on PIC16F887 and 20us on PIC16F877A.
+#define ADC_TACQ_US(ohms)	((3250UL + ((8000UL + (ohms)) * ADC_CHOLD_PF / 1000) * 7624 / 1000 + 999) / 1000)
+
+// One channel of the scan list. The filter stages run in this order, 0 turns
+// a stage off. The result of a stage has 10 bits plus the oversample bits, it
+// must still fit in 16 bits after the boxcar or IIR shift.
+typedef struct {
+	unsigned char uc_channel;			// 0 for AN0, 4 for AN4...
+	unsigned char uc_acquisition_us;	// ADC_TACQ_US(source impedance), not more than 255
+	unsigned char uc_oversample_bits;	// sum 4^n samples into one with n more bits, 0 - 3
+	unsigned char uc_boxcar_bits;		// average of every 2^n values, 0 - 6
+	unsigned char uc_iir_shift;			// y += (x - y) / 2^n, 0 - 6
+} ADC_CHANNEL;
+
 
 
 /*******************************************************************************
@@ -42,11 +69,142 @@ extern void adc_init(void);
 * ~ The ADC result in 16 bit
 *
 * DESCRIPTIONS:
-* Convert and read the result of the ADC at channel 0.
+* Convert and read the result of the ADC at channel 0. The acquisition time
+* for ADC_SOURCE_OHMS is only waited when the channel was changed. A running
+* scan is paused, after the scan in progress is finished, and goes on after.
 *
 *******************************************************************************/
 extern unsigned int ui_adc_read(void);
 
 
 
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_adc_scan_start
+*
+* PARAMETERS:
+* ~ cs_channels		- List of analog channels to scan, with their acquisition
+*					  time.
+* ~ uc_count		- Number of channels in the list, 1 to ADC_MAX_CHANNELS.
+*
+* RETURN:
+* ~ 1 if the scan is started, 0 if the list can not be used.
+*
+* DESCRIPTIONS:
+* Make the listed pins analog inputs and convert them one after another in the
+* background, a scan every ADC_SAMPLE_PERIOD_MS from the 1ms system tick, so
+* the sample period does not depend on the main program. The acquisition time
+* of a channel is skipped when it is the only channel in the list. Timer 0
+* must be initialized and the pins must already be inputs. On MC40SE AN0,
+* AN1 (SEN7) and AN4 (SEN8) can be used, and AN8 - AN13 (SEN1 - SEN6) on
+* PIC16F887. AN5 - AN7 drive RUN1, DIR1 and LCD_E, they are refused.
+* AN2 and AN3 are SW1 and SW2, the switches can not be read while they are
+* analog. PIC16F877A can only make AN0 alone, AN0, AN1 and AN3 or AN0 - AN4
+* analog, so a list with AN2 or AN4 also makes SW1 and SW2 analog, and a list
+* with AN1 also makes SW2 analog.
+* ui_adc_read pauses the scan for its own conversion.
+*
+*******************************************************************************/
+extern unsigned char uc_adc_scan_start(const ADC_CHANNEL* cs_channels, unsigned char uc_count);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: adc_scan_stop
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Stop the scan and turn off the ADC. The last results can still be read.
+*
+*******************************************************************************/
+extern void adc_scan_stop(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_adc_get
+*
+* PARAMETERS:
+* ~ uc_channel	- Analog channel, one of the channels in the scan list.
+*
+* RETURN:
+* ~ The latest result of the channel, or ADC_NO_RESULT if the channel is not
+*   scanned or no scan has finished yet.
+*
+* DESCRIPTIONS:
+* Read the result of a channel from the last finished scan. This function does
+* not block.
+*
+*******************************************************************************/
+extern unsigned int ui_adc_get(unsigned char uc_channel);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: adc_get_scan
+*
+* PARAMETERS:
+* ~ pui_results	- Where to store the results, one for each channel in the
+*				  scan list, in the same order.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Copy the results of all channels from the last finished scan, so they are
+* all from the same scan.
+*
+*******************************************************************************/
+extern void adc_get_scan(unsigned int* pui_results);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_adc_filtered
+*
+* PARAMETERS:
+* ~ uc_channel	- Analog channel, one of the channels in the scan list.
+*
+* RETURN:
+* ~ The latest output of the filter of the channel, or ADC_NO_RESULT if the
+*   channel is not scanned or the filter has no output yet.
+*
+* DESCRIPTIONS:
+* Read the filtered value of a channel. With oversampling it has more than 10
+* bits. A new value comes every ADC_SAMPLE_PERIOD_MS x 4^oversample x
+* 2^boxcar ms. This function does not block.
+*
+*******************************************************************************/
+extern unsigned int ui_adc_filtered(unsigned char uc_channel);
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for ADC
+*
+* DESCRIPTIONS:
+* Store and filter the result of the finished conversion and start the next
+* channel of the scan.
+*
+*******************************************************************************/
+extern void adc_isr(void);
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for ADC, 1ms tick
+*
+* DESCRIPTIONS:
+* Start a scan every ADC_SAMPLE_PERIOD_MS. If the last scan is not finished,
+* this one is skipped. Call after timer0_isr.
+*
+*******************************************************************************/
+extern void adc_tick(void);
+
+
+
 #endif
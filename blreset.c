@@ -0,0 +1,101 @@
+/*******************************************************************************
+* This file provides the functions for the brushless motor driver reset on
+* MC40SE, the BL_R pulse is timed by the 1ms system tick
+* Author: Cytron Technologies Sdn. Bhd.
+*
+* BL_R is RA7, one of the oscillator pins. It can only be used on PIC16F887
+* with the internal oscillator and JP27 (BL_R) connected.
+*******************************************************************************/
+
+
+
+#include <htc.h>
+#include "system.h"
+#include "blreset.h"
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+// ms left of the pulse and the settle time, 0 = idle.
+static volatile unsigned char uc_blreset_timer = 0;
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: blreset_start
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Start a reset pulse on BL_R to clear the alarm of both brushless motor
+* drivers and return immediately. BL_R is low for BLRESET_PULSE_MS to
+* BLRESET_PULSE_MS + 1, then the drivers are given BLRESET_SETTLE_MS. Do not
+* let the motors run until uc_blreset_busy returns 0. A new start during a pulse starts it
+* again. Does nothing on PIC16F877A, it has no BL_R.
+*
+*******************************************************************************/
+void blreset_start(void)
+{
+#if defined (_16F887)
+	GIE = 0;
+	BL_R = 0;		// active low
+	// the first tick can come at once, 1 more keeps the pulse BLRESET_PULSE_MS
+	uc_blreset_timer = BLRESET_PULSE_MS + 1 + BLRESET_SETTLE_MS;
+	GIE = 1;
+#endif
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_blreset_busy
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ 1 during the reset pulse and the settle time, 0 after.
+*
+* DESCRIPTIONS:
+* Check if the brushless motor drivers are being reset. This function does
+* not block.
+*
+*******************************************************************************/
+unsigned char uc_blreset_busy(void)
+{
+	if (uc_blreset_timer != 0) return 1;
+	return 0;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: blreset_tick
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Time the reset pulse. Called by the ISR on every 1ms system tick.
+*
+*******************************************************************************/
+void blreset_tick(void)
+{
+	if (uc_blreset_timer == 0) return;
+	
+	if (--uc_blreset_timer == BLRESET_SETTLE_MS) {
+#if defined (_16F887)
+		BL_R = 1;	// release the drivers
+#endif
+	}
+}
@@ -0,0 +1,72 @@
+/*******************************************************************************
+* This file provides the functions for the brushless motor driver reset on
+* MC40SE, the BL_R pulse is timed by the 1ms system tick
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#ifndef _BLRESET_H
+#define _BLRESET_H
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION PROTOTYPES                                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* PUBLIC FUNCTION: blreset_start
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Start a reset pulse on BL_R to clear the alarm of both brushless motor
+* drivers and return immediately. BL_R is low for BLRESET_PULSE_MS to
+* BLRESET_PULSE_MS + 1, then the drivers are given BLRESET_SETTLE_MS. Do not
+* let the motors run until uc_blreset_busy returns 0. A new start during a pulse starts it
+* again. Does nothing on PIC16F877A, it has no BL_R.
+*
+*******************************************************************************/
+extern void blreset_start(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_blreset_busy
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ 1 during the reset pulse and the settle time, 0 after.
+*
+* DESCRIPTIONS:
+* Check if the brushless motor drivers are being reset. This function does
+* not block.
+*
+*******************************************************************************/
+extern unsigned char uc_blreset_busy(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: blreset_tick
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Time the reset pulse. Called by the ISR on every 1ms system tick.
+*
+*******************************************************************************/
+extern void blreset_tick(void);
+
+#endif
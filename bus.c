@@ -0,0 +1,302 @@
+/*******************************************************************************
+* This file provides the functions for the PORTD bus on MC40SE, shared by the
+* LCD and the relay latch, PIC16F887 or PIC16F877A
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#include <htc.h>
+#include "system.h"
+#include "bus.h"
+
+
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+// Time LATCH is held high, the latch only needs a few ns.
+#define LATCH_PULSE_US		1
+
+// LCD view of PORTD, RS on RD0 and the data nibble on RD4 - RD7.
+#define LCD_VIEW(b_rs, uc_nibble)	(((uc_nibble) & 0xF0) | ((b_rs) & 0x01))
+
+// Put the view of the new owner on PORTD, the bus is already taken.
+#define BUS_DRIVE(uc_owner)	do {\
+								if ((uc_owner) == BUS_LCD) PORTD = uc_bus_lcd;\
+								else PORTD = uc_bus_latch;\
+							} while (0)
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+static volatile unsigned char uc_bus_owner = BUS_FREE;
+
+// View of PORTD of each owner.
+static unsigned char uc_bus_lcd = 0;
+static unsigned char uc_bus_latch = 0;
+
+// Latch outputs that must stay off, set by the ISR.
+static volatile unsigned char uc_bus_latch_cut = 0;
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Free the bus and clear both views. Call before lcd_init and relay_init.
+*
+*******************************************************************************/
+void bus_init(void)
+{
+	LATCH = 0;		// hold the output of latch
+	uc_bus_lcd = 0;
+	uc_bus_latch = 0;
+	uc_bus_latch_cut = 0;
+	PORTD = 0;
+	uc_bus_owner = BUS_FREE;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_bus_acquire
+*
+* PARAMETERS:
+* ~ uc_owner		- BUS_LCD or BUS_LATCH.
+*
+* RETURN:
+* ~ 1 if the bus is taken, 0 if it is in use.
+*
+* DESCRIPTIONS:
+* Take the bus from main code and put the view of uc_owner on PORTD. This
+* function does not block.
+*
+*******************************************************************************/
+unsigned char uc_bus_acquire(unsigned char uc_owner)
+{
+	// The ISR never holds the bus when it returns, so only the test and set
+	// need to be protected.
+	GIE = 0;
+	if (uc_bus_owner != BUS_FREE) {
+		GIE = 1;
+		return 0;
+	}
+	uc_bus_owner = uc_owner;
+	GIE = 1;
+	
+	BUS_DRIVE(uc_owner);
+	return 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_release
+*
+* PARAMETERS:
+* ~ uc_owner		- BUS_LCD or BUS_LATCH, the owner of the bus.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* End the transaction of main code.
+*
+*******************************************************************************/
+void bus_release(unsigned char uc_owner)
+{
+	if (uc_bus_owner == uc_owner) uc_bus_owner = BUS_FREE;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_lcd_put
+*
+* PARAMETERS:
+* ~ b_rs			- The output of the LCD RS pin (1 or 0).
+* ~ uc_nibble		- The LCD data in bit 4 - 7.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the LCD view from main code. Only in a BUS_LCD transaction, the LCD
+* takes the data on the falling edge of LCD_E.
+*
+*******************************************************************************/
+void bus_lcd_put(unsigned char b_rs, unsigned char uc_nibble)
+{
+	uc_bus_lcd = LCD_VIEW(b_rs, uc_nibble);
+	if (uc_bus_owner == BUS_LCD) PORTD = uc_bus_lcd;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_latch_put
+*
+* PARAMETERS:
+* ~ uc_frame		- All 8 latch outputs, bit 0 is output 1.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the latch view from main code and strobe LATCH. Only in a BUS_LATCH
+* transaction. Outputs cut by bus_tick_latch_cut stay off.
+*
+*******************************************************************************/
+void bus_latch_put(unsigned char uc_frame)
+{
+	if (uc_bus_owner != BUS_LATCH) return;
+	
+	// A cut in the ISR between the mask and the strobe would be undone.
+	GIE = 0;
+	uc_bus_latch = uc_frame & ~uc_bus_latch_cut;
+	PORTD = uc_bus_latch;
+	LATCH = 1;		// transfer the new output to relay
+	__delay_us(LATCH_PULSE_US);
+	LATCH = 0;		// hold the output of latch
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_bus_latch_unchanged
+*
+* PARAMETERS:
+* ~ uc_frame		- All 8 latch outputs, bit 0 is output 1.
+*
+* RETURN:
+* ~ 1 if bus_latch_put(uc_frame) would not change the latch outputs, else 0.
+*
+* DESCRIPTIONS:
+* Compare a frame with the latch outputs from main code, outputs cut by
+* bus_tick_latch_cut count as off.
+*
+*******************************************************************************/
+unsigned char uc_bus_latch_unchanged(unsigned char uc_frame)
+{
+	unsigned char b_unchanged = 0;
+	
+	GIE = 0;		// the ISR may cut an output in between
+	if ((uc_frame & ~uc_bus_latch_cut) == uc_bus_latch) b_unchanged = 1;
+	GIE = 1;
+	return b_unchanged;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_bus_tick_acquire
+*
+* PARAMETERS:
+* ~ uc_owner		- BUS_LCD or BUS_LATCH.
+*
+* RETURN:
+* ~ 1 if the bus is taken, 0 if main code has it.
+*
+* DESCRIPTIONS:
+* Same as uc_bus_acquire, for the ISR only.
+*
+*******************************************************************************/
+unsigned char uc_bus_tick_acquire(unsigned char uc_owner)
+{
+	if (uc_bus_owner != BUS_FREE) return 0;
+	uc_bus_owner = uc_owner;
+	
+	BUS_DRIVE(uc_owner);
+	return 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_tick_release
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Same as bus_release, for the ISR only. The ISR always ends its transaction
+* before it returns.
+*
+*******************************************************************************/
+void bus_tick_release(void)
+{
+	uc_bus_owner = BUS_FREE;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_tick_lcd_put
+*
+* PARAMETERS:
+* ~ b_rs			- The output of the LCD RS pin (1 or 0).
+* ~ uc_nibble		- The LCD data in bit 4 - 7.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Same as bus_lcd_put, for the ISR only.
+*
+*******************************************************************************/
+void bus_tick_lcd_put(unsigned char b_rs, unsigned char uc_nibble)
+{
+	uc_bus_lcd = LCD_VIEW(b_rs, uc_nibble);
+	if (uc_bus_owner == BUS_LCD) PORTD = uc_bus_lcd;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_tick_latch_cut
+*
+* PARAMETERS:
+* ~ uc_mask			- Latch outputs to keep off, bit 0 is output 1. 0 to allow
+*					  all outputs again.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Keep the latch outputs in uc_mask off, for the ISR only. An output in
+* uc_mask that is on is turned off at once with a LATCH strobe, also in the
+* middle of a transaction of main code, and the view of the owner is put back
+* on PORTD. An output let go stays off until main code commits it again.
+*
+*******************************************************************************/
+void bus_tick_latch_cut(unsigned char uc_mask)
+{
+	uc_bus_latch_cut = uc_mask;
+	if ((uc_bus_latch & uc_mask) == 0) return;
+	
+	// The LCD only takes PORTD on LCD_E and main code strobes LATCH with
+	// interrupts off, so PORTD can be borrowed for the strobe.
+	uc_bus_latch &= ~uc_mask;
+	PORTD = uc_bus_latch;
+	LATCH = 1;		// transfer the new output to relay
+	__delay_us(LATCH_PULSE_US);
+	LATCH = 0;		// hold the output of latch
+	
+	if (uc_bus_owner == BUS_LCD) PORTD = uc_bus_lcd;
+}
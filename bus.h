@@ -0,0 +1,215 @@
+/*******************************************************************************
+* This file provides the functions for the PORTD bus on MC40SE, shared by the
+* LCD and the relay latch, PIC16F887 or PIC16F877A
+* Author: Cytron Technologies Sdn. Bhd.
+*
+* A user of PORTD takes the bus for a transaction, writes its own view of PORTD
+* and releases the bus. Each user has a shadow of its view, PORTD is set to it
+* when the bus is taken, so nothing needs to be saved and restored.
+* LCD view   : RD0 = LCD_RS, RD4 - RD7 = LCD data nibble, latched by LCD_E
+* Latch view : RD0 - RD7 = latch outputs 1 - 8, latched by LATCH
+* A transaction must not wait for anything outside it. Main code and the ISR
+* use their own functions, the ISR skips its work if main code has the bus.
+* Only a cut of latch outputs (limit switches) goes through at any time.
+*******************************************************************************/
+
+
+
+#ifndef _BUS_H
+#define _BUS_H
+
+
+
+// Owner of the bus
+#define BUS_FREE		0
+#define BUS_LCD			1
+#define BUS_LATCH		2
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION PROTOTYPES                                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Free the bus and clear both views. Call before lcd_init and relay_init.
+*
+*******************************************************************************/
+extern void bus_init(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_bus_acquire
+*
+* PARAMETERS:
+* ~ uc_owner		- BUS_LCD or BUS_LATCH.
+*
+* RETURN:
+* ~ 1 if the bus is taken, 0 if it is in use.
+*
+* DESCRIPTIONS:
+* Take the bus from main code and put the view of uc_owner on PORTD. This
+* function does not block.
+*
+*******************************************************************************/
+extern unsigned char uc_bus_acquire(unsigned char uc_owner);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_release
+*
+* PARAMETERS:
+* ~ uc_owner		- BUS_LCD or BUS_LATCH, the owner of the bus.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* End the transaction of main code.
+*
+*******************************************************************************/
+extern void bus_release(unsigned char uc_owner);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_lcd_put
+*
+* PARAMETERS:
+* ~ b_rs			- The output of the LCD RS pin (1 or 0).
+* ~ uc_nibble		- The LCD data in bit 4 - 7.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the LCD view from main code. Only in a BUS_LCD transaction, the LCD
+* takes the data on the falling edge of LCD_E.
+*
+*******************************************************************************/
+extern void bus_lcd_put(unsigned char b_rs, unsigned char uc_nibble);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_latch_put
+*
+* PARAMETERS:
+* ~ uc_frame		- All 8 latch outputs, bit 0 is output 1.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the latch view from main code and strobe LATCH. Only in a BUS_LATCH
+* transaction. Outputs cut by bus_tick_latch_cut stay off.
+*
+*******************************************************************************/
+extern void bus_latch_put(unsigned char uc_frame);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_bus_latch_unchanged
+*
+* PARAMETERS:
+* ~ uc_frame		- All 8 latch outputs, bit 0 is output 1.
+*
+* RETURN:
+* ~ 1 if bus_latch_put(uc_frame) would not change the latch outputs, else 0.
+*
+* DESCRIPTIONS:
+* Compare a frame with the latch outputs from main code, outputs cut by
+* bus_tick_latch_cut count as off.
+*
+*******************************************************************************/
+extern unsigned char uc_bus_latch_unchanged(unsigned char uc_frame);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_bus_tick_acquire
+*
+* PARAMETERS:
+* ~ uc_owner		- BUS_LCD or BUS_LATCH.
+*
+* RETURN:
+* ~ 1 if the bus is taken, 0 if main code has it.
+*
+* DESCRIPTIONS:
+* Same as uc_bus_acquire, for the ISR only.
+*
+*******************************************************************************/
+extern unsigned char uc_bus_tick_acquire(unsigned char uc_owner);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_tick_release
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Same as bus_release, for the ISR only. The ISR always ends its transaction
+* before it returns.
+*
+*******************************************************************************/
+extern void bus_tick_release(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_tick_lcd_put
+*
+* PARAMETERS:
+* ~ b_rs			- The output of the LCD RS pin (1 or 0).
+* ~ uc_nibble		- The LCD data in bit 4 - 7.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Same as bus_lcd_put, for the ISR only.
+*
+*******************************************************************************/
+extern void bus_tick_lcd_put(unsigned char b_rs, unsigned char uc_nibble);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: bus_tick_latch_cut
+*
+* PARAMETERS:
+* ~ uc_mask			- Latch outputs to keep off, bit 0 is output 1. 0 to allow
+*					  all outputs again.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Keep the latch outputs in uc_mask off, for the ISR only. An output in
+* uc_mask that is on is turned off at once with a LATCH strobe, also in the
+* middle of a transaction of main code, and the view of the owner is put back
+* on PORTD. An output let go stays off until main code commits it again.
+*
+*******************************************************************************/
+extern void bus_tick_latch_cut(unsigned char uc_mask);
+
+
+
+#endif
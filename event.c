@@ -0,0 +1,216 @@
+/*******************************************************************************
+* This file provides the functions for the button event queue on MC40SE,
+* press and release of SKPS buttons, SW1 and SW2, and limit switch cut-offs
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#include <htc.h>
+#include "system.h"
+#include "event.h"
+#include "timer0.h"
+
+
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+// Bits of SW1 and SW2 in the switch state, 1 = pressed.
+#define SWITCH_SW1			0b00000001
+#define SWITCH_SW2			0b00000010
+
+// State of SW1 and SW2, bit set = pressed, the push buttons are active low.
+#define SWITCH_READ()		(((SW1 == 0) ? SWITCH_SW1 : 0) | ((SW2 == 0) ? SWITCH_SW2 : 0))
+
+// Queue one event, if the queue is full the new event is dropped. The main
+// program must disable interrupts around it.
+#define EVENT_PUSH(uc_event_id, uc_event_type, ui_event_time)	do {\
+								unsigned char uc_next = (uc_head + 1) & (EVENT_QUEUE_SIZE - 1);\
+								if (uc_next != uc_tail) {\
+									s_queue[uc_head].uc_id = (uc_event_id);\
+									s_queue[uc_head].uc_type = (uc_event_type);\
+									s_queue[uc_head].ui_time = (ui_event_time);\
+									uc_head = uc_next;\
+								}\
+							} while (0)
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+// Event queue, written by event_tick (ISR) and event_skps_update (main program),
+// read by the main program.
+static EVENT s_queue[EVENT_QUEUE_SIZE];
+static volatile unsigned char uc_head = 0;
+static volatile unsigned char uc_tail = 0;
+
+// Previous state of the buttons.
+static unsigned int ui_skps_buttons = 0;		// bit n set = SKPS button p_n pressed
+static unsigned char uc_switch_stable = 0;		// debounced SW1 and SW2
+static unsigned char uc_switch_sample = 0;		// last sample of SW1 and SW2
+static unsigned char uc_switch_timer = 0;		// ms to the next sample
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: event_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Empty the event queue and take the present state of SW1 and SW2, so a switch
+* held during start up does not give an event. Timer 0 must be initialized.
+*
+*******************************************************************************/
+void event_init(void)
+{
+	GIE = 0;
+	uc_head = 0;
+	uc_tail = 0;
+	ui_skps_buttons = 0;
+	uc_switch_stable = SWITCH_READ();
+	uc_switch_sample = uc_switch_stable;
+	uc_switch_timer = EVENT_SWITCH_SAMPLE_MS;
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: event_skps_update
+*
+* PARAMETERS:
+* ~ ui_buttons	- button bits of the latest SKPS snapshot
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Compare the buttons with the previous snapshot and queue a press or release
+* event for every button that changed.
+*
+*******************************************************************************/
+void event_skps_update(unsigned int ui_buttons)
+{
+	unsigned int ui_changed = ui_buttons ^ ui_skps_buttons;
+	unsigned char uc_id;
+	
+	ui_skps_buttons = ui_buttons;
+	
+	for (uc_id = 0; ui_changed != 0; uc_id++, ui_changed >>= 1, ui_buttons >>= 1) {
+		if ((ui_changed & 1) == 0) continue;
+		
+		GIE = 0;		// event_tick may push at the same time
+		EVENT_PUSH(uc_id, (ui_buttons & 1) ? EVENT_PRESS : EVENT_RELEASE, ui_millis());
+		GIE = 1;
+	}
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_event_get
+*
+* PARAMETERS:
+* ~ ps_event	- where to store the oldest event
+*
+* RETURN:
+* ~ 1 if an event is taken from the queue, 0 if the queue is empty
+*
+* DESCRIPTIONS:
+* Take the oldest event from the queue. This function does not block.
+*
+*******************************************************************************/
+unsigned char uc_event_get(EVENT* ps_event)
+{
+	if (uc_head == uc_tail) {
+		return 0;
+	}
+	
+	*ps_event = s_queue[uc_tail];
+	uc_tail = (uc_tail + 1) & (EVENT_QUEUE_SIZE - 1);
+	return 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: event_flush
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Drop every event waiting in the queue.
+*
+*******************************************************************************/
+void event_flush(void)
+{
+	uc_tail = uc_head;
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for the event queue, 1ms tick
+*
+* DESCRIPTIONS:
+* Sample SW1 and SW2 every EVENT_SWITCH_SAMPLE_MS and queue their changes.
+* A change is taken only when two samples in a row agree, so contact bounce
+* does not give extra events. Call after timer0_isr.
+*
+*******************************************************************************/
+void event_tick(void)
+{
+	unsigned char uc_sample;
+	unsigned char uc_changed;
+	
+	if (--uc_switch_timer != 0) return;
+	uc_switch_timer = EVENT_SWITCH_SAMPLE_MS;
+	
+	uc_sample = SWITCH_READ();
+	uc_changed = (uc_sample ^ uc_switch_stable) & ~(uc_sample ^ uc_switch_sample);
+	uc_switch_sample = uc_sample;
+	if (uc_changed == 0) return;
+	
+	uc_switch_stable ^= uc_changed;
+	if (uc_changed & SWITCH_SW1) {
+		event_tick_push(EVENT_SW1, (uc_sample & SWITCH_SW1) ? EVENT_PRESS : EVENT_RELEASE);
+	}
+	if (uc_changed & SWITCH_SW2) {
+		event_tick_push(EVENT_SW2, (uc_sample & SWITCH_SW2) ? EVENT_PRESS : EVENT_RELEASE);
+	}
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: event_tick_push
+*
+* PARAMETERS:
+* ~ uc_id		- source of the event
+* ~ uc_type		- EVENT_PRESS, EVENT_RELEASE or EVENT_CUTOFF
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Queue one event stamped with the system tick, for the ISR only. If the queue
+* is full the new event is dropped.
+*
+*******************************************************************************/
+void event_tick_push(unsigned char uc_id, unsigned char uc_type)
+{
+	EVENT_PUSH(uc_id, uc_type, ui_tick_millis());
+}
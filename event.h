@@ -0,0 +1,137 @@
+/*******************************************************************************
+* This file provides the functions for the button event queue on MC40SE,
+* press and release of SKPS buttons, SW1 and SW2, and limit switch cut-offs
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#ifndef _EVENT_H
+#define _EVENT_H
+
+// Event source, SKPS buttons use their command constant p_select to p_square
+#define EVENT_SW1		16		// push button SW1 on MC40SE
+#define EVENT_SW2		17		// push button SW2 on MC40SE
+#define EVENT_LIMIT1	18		// limit switch 1 to 4, see limit.h
+#define EVENT_LIMIT2	19
+#define EVENT_LIMIT3	20
+#define EVENT_LIMIT4	21
+
+// Event type
+#define EVENT_PRESS		0
+#define EVENT_RELEASE	1
+#define EVENT_CUTOFF	2		// a limit switch closed and its relay is held off
+
+// One button event
+typedef struct {
+	unsigned char uc_id;		// p_select to p_square, EVENT_SW1, EVENT_SW2 or EVENT_LIMITn
+	unsigned char uc_type;		// EVENT_PRESS, EVENT_RELEASE or EVENT_CUTOFF
+	unsigned int ui_time;		// system tick (ui_millis) when the change was seen
+} EVENT;
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION PROTOTYPES                                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* PUBLIC FUNCTION: event_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Empty the event queue and take the present state of SW1 and SW2, so a switch
+* held during start up does not give an event. Timer 0 must be initialized.
+*
+*******************************************************************************/
+extern void event_init(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: event_skps_update
+*
+* PARAMETERS:
+* ~ ui_buttons	- button bits of the latest SKPS snapshot
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Compare the buttons with the previous snapshot and queue a press or release
+* event for every button that changed.
+*
+*******************************************************************************/
+extern void event_skps_update(unsigned int ui_buttons);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_event_get
+*
+* PARAMETERS:
+* ~ ps_event	- where to store the oldest event
+*
+* RETURN:
+* ~ 1 if an event is taken from the queue, 0 if the queue is empty
+*
+* DESCRIPTIONS:
+* Take the oldest event from the queue. This function does not block.
+*
+*******************************************************************************/
+extern unsigned char uc_event_get(EVENT* ps_event);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: event_flush
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Drop every event waiting in the queue.
+*
+*******************************************************************************/
+extern void event_flush(void);
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for the event queue, 1ms tick
+*
+* DESCRIPTIONS:
+* Sample SW1 and SW2 every EVENT_SWITCH_SAMPLE_MS and queue their changes.
+* Call after timer0_isr.
+*
+*******************************************************************************/
+extern void event_tick(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: event_tick_push
+*
+* PARAMETERS:
+* ~ uc_id		- source of the event
+* ~ uc_type		- EVENT_PRESS, EVENT_RELEASE or EVENT_CUTOFF
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Queue one event stamped with the system tick, for the ISR only. If the queue
+* is full the new event is dropped.
+*
+*******************************************************************************/
+extern void event_tick_push(unsigned char uc_id, unsigned char uc_type);
+
+#endif
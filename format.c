@@ -0,0 +1,198 @@
+/*******************************************************************************
+* This file provides the functions to format numbers into text for the LCD and
+* UART on MC40SE, without any division
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#include <htc.h>
+#include "format.h"
+
+
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+// Powers of ten for the digits of an unsigned int, PIC16 has no divide
+// instruction so each digit is found by subtracting its power of ten.
+const unsigned int cui_power_of_ten[5] = {10000, 1000, 100, 10, 1};
+
+// Hex digits.
+const char cc_hex_digit[16] = "0123456789ABCDEF";
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_format_uint
+*
+* PARAMETERS:
+* ~ sz_buffer	- Where to store the text, FORMAT_BUFFER_SIZE bytes.
+* ~ ui_value	- The number to format.
+* ~ uc_width	- Number of characters, 0 to use as many as needed.
+* ~ c_pad		- Character to fill the front with, '0' or ' '.
+*
+* RETURN:
+* ~ Length of the text.
+*
+* DESCRIPTIONS:
+* Format an unsigned number in decimal. If the number is longer than uc_width,
+* only the lowest uc_width digits are kept.
+*
+*******************************************************************************/
+unsigned char uc_format_uint(char* sz_buffer, unsigned int ui_value, unsigned char uc_width, char c_pad)
+{
+	char c_digit[5];
+	unsigned char uc_index;
+	unsigned char uc_length = 5;	// number of digits needed
+	unsigned char uc_out = 0;
+	
+	// Split into 5 digits, at most 9 subtractions for each digit.
+	for (uc_index = 0; uc_index < 5; uc_index++) {
+		c_digit[uc_index] = '0';
+		while (ui_value >= cui_power_of_ten[uc_index]) {
+			ui_value -= cui_power_of_ten[uc_index];
+			c_digit[uc_index]++;
+		}
+	}
+	
+	// Leading zeros are not needed, but keep the last digit.
+	for (uc_index = 0; (uc_index < 4) && (c_digit[uc_index] == '0'); uc_index++) {
+		uc_length--;
+	}
+	
+	if (uc_width > FORMAT_BUFFER_SIZE - 1) uc_width = FORMAT_BUFFER_SIZE - 1;
+	if (uc_width == 0) uc_width = uc_length;
+	
+	// Fill the front, or drop the higher digits if there is no space for them.
+	for ( ; uc_width > uc_length; uc_width--) {
+		sz_buffer[uc_out++] = c_pad;
+	}
+	for (uc_index = 5 - uc_width; uc_index < 5; uc_index++) {
+		sz_buffer[uc_out++] = c_digit[uc_index];
+	}
+	sz_buffer[uc_out] = '\0';
+	return uc_out;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_format_int
+*
+* PARAMETERS:
+* ~ sz_buffer	- Where to store the text, FORMAT_BUFFER_SIZE bytes.
+* ~ i_value		- The number to format.
+* ~ uc_width	- Number of characters including the sign, 0 to use as many as
+*				  needed.
+* ~ c_pad		- Character to fill the front with, '0' or ' '.
+*
+* RETURN:
+* ~ Length of the text.
+*
+* DESCRIPTIONS:
+* Format a signed number in decimal. A negative number starts with '-', before
+* the zeros with '0' padding or after the spaces with ' ' padding.
+*
+*******************************************************************************/
+unsigned char uc_format_int(char* sz_buffer, int i_value, unsigned char uc_width, char c_pad)
+{
+	unsigned char uc_index;
+	
+	if (i_value >= 0) {
+		return uc_format_uint(sz_buffer, (unsigned int)i_value, uc_width, c_pad);
+	}
+	
+	// Format the magnitude after the sign, then move the sign behind the spaces.
+	// The magnitude is negated as unsigned, -32768 has no positive int.
+	if (uc_width > FORMAT_BUFFER_SIZE - 1) uc_width = FORMAT_BUFFER_SIZE - 1;
+	if (uc_width == 1) uc_width = 2;
+	if (uc_width != 0) uc_width--;
+	sz_buffer[0] = ' ';
+	uc_width = uc_format_uint(sz_buffer + 1, (unsigned int)0 - (unsigned int)i_value, uc_width, c_pad);
+	for (uc_index = 0; sz_buffer[uc_index + 1] == ' '; uc_index++) continue;
+	sz_buffer[uc_index] = '-';
+	return uc_width + 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_format_hex
+*
+* PARAMETERS:
+* ~ sz_buffer	- Where to store the text, FORMAT_BUFFER_SIZE bytes.
+* ~ ui_value	- The number to format.
+* ~ uc_digits	- Number of hex digits, 1 to 4.
+*
+* RETURN:
+* ~ Length of the text.
+*
+* DESCRIPTIONS:
+* Format the lowest uc_digits hex digits of a number, in upper case.
+*
+*******************************************************************************/
+unsigned char uc_format_hex(char* sz_buffer, unsigned int ui_value, unsigned char uc_digits)
+{
+	unsigned char uc_index;
+	
+	if (uc_digits == 0) uc_digits = 1;
+	if (uc_digits > 4) uc_digits = 4;
+	
+	// Fill from the last digit, 4 bits each.
+	sz_buffer[uc_digits] = '\0';
+	for (uc_index = uc_digits; uc_index > 0; uc_index--) {
+		sz_buffer[uc_index - 1] = cc_hex_digit[ui_value & 0x0F];
+		ui_value >>= 4;
+	}
+	return uc_digits;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_format_q8_8
+*
+* PARAMETERS:
+* ~ sz_buffer	- Where to store the text, FORMAT_BUFFER_SIZE bytes.
+* ~ i_value		- Signed fixed point number, 8 integer bits and 8 fraction
+*				  bits (256 = 1.0).
+* ~ uc_decimals	- Number of digits after the decimal point, 1 to 4.
+*
+* RETURN:
+* ~ Length of the text.
+*
+* DESCRIPTIONS:
+* Format a Q8.8 fixed point number in decimal, for example 0x0180 is "1.50".
+* The fraction is truncated, not rounded.
+*
+*******************************************************************************/
+unsigned char uc_format_q8_8(char* sz_buffer, int i_value, unsigned char uc_decimals)
+{
+	unsigned int ui_value = (unsigned int)i_value;
+	unsigned int ui_fraction;
+	unsigned char uc_out = 0;
+	
+	if (uc_decimals == 0) uc_decimals = 1;
+	if (uc_decimals > 4) uc_decimals = 4;
+	
+	// Sign, also for values between -1 and 0 where the integer part is 0.
+	if (i_value < 0) {
+		sz_buffer[uc_out++] = '-';
+		ui_value = (unsigned int)0 - (unsigned int)i_value;
+	}
+	
+	uc_out += uc_format_uint(sz_buffer + uc_out, ui_value >> 8, 0, ' ');
+	sz_buffer[uc_out++] = '.';
+	
+	// Each digit of the fraction is the integer part of the fraction x 10.
+	ui_fraction = ui_value & 0xFF;
+	for ( ; uc_decimals > 0; uc_decimals--) {
+		ui_fraction = (ui_fraction << 3) + (ui_fraction << 1);
+		sz_buffer[uc_out++] = '0' + (char)(ui_fraction >> 8);
+		ui_fraction &= 0xFF;
+	}
+	sz_buffer[uc_out] = '\0';
+	return uc_out;
+}
@@ -0,0 +1,102 @@
+/*******************************************************************************
+* This file provides the functions to format numbers into text for the LCD and
+* UART on MC40SE, without any division
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#ifndef _FORMAT_H
+#define _FORMAT_H
+
+// Size of the buffer for the format functions, fits "-32768" and "-128.9999".
+#define FORMAT_BUFFER_SIZE		10
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION PROTOTYPES                                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_format_uint
+*
+* PARAMETERS:
+* ~ sz_buffer	- Where to store the text, FORMAT_BUFFER_SIZE bytes.
+* ~ ui_value	- The number to format.
+* ~ uc_width	- Number of characters, 0 to use as many as needed.
+* ~ c_pad		- Character to fill the front with, '0' or ' '.
+*
+* RETURN:
+* ~ Length of the text.
+*
+* DESCRIPTIONS:
+* Format an unsigned number in decimal. If the number is longer than uc_width,
+* only the lowest uc_width digits are kept.
+*
+*******************************************************************************/
+extern unsigned char uc_format_uint(char* sz_buffer, unsigned int ui_value, unsigned char uc_width, char c_pad);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_format_int
+*
+* PARAMETERS:
+* ~ sz_buffer	- Where to store the text, FORMAT_BUFFER_SIZE bytes.
+* ~ i_value		- The number to format.
+* ~ uc_width	- Number of characters including the sign, 0 to use as many as
+*				  needed.
+* ~ c_pad		- Character to fill the front with, '0' or ' '.
+*
+* RETURN:
+* ~ Length of the text.
+*
+* DESCRIPTIONS:
+* Format a signed number in decimal. A negative number starts with '-', before
+* the zeros with '0' padding or after the spaces with ' ' padding.
+*
+*******************************************************************************/
+extern unsigned char uc_format_int(char* sz_buffer, int i_value, unsigned char uc_width, char c_pad);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_format_hex
+*
+* PARAMETERS:
+* ~ sz_buffer	- Where to store the text, FORMAT_BUFFER_SIZE bytes.
+* ~ ui_value	- The number to format.
+* ~ uc_digits	- Number of hex digits, 1 to 4.
+*
+* RETURN:
+* ~ Length of the text.
+*
+* DESCRIPTIONS:
+* Format the lowest uc_digits hex digits of a number, in upper case.
+*
+*******************************************************************************/
+extern unsigned char uc_format_hex(char* sz_buffer, unsigned int ui_value, unsigned char uc_digits);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_format_q8_8
+*
+* PARAMETERS:
+* ~ sz_buffer	- Where to store the text, FORMAT_BUFFER_SIZE bytes.
+* ~ i_value		- Signed fixed point number, 8 integer bits and 8 fraction
+*				  bits (256 = 1.0).
+* ~ uc_decimals	- Number of digits after the decimal point, 1 to 4.
+*
+* RETURN:
+* ~ Length of the text.
+*
+* DESCRIPTIONS:
+* Format a Q8.8 fixed point number in decimal, for example 0x0180 is "1.50".
+* The fraction is truncated, not rounded.
+*
+*******************************************************************************/
+extern unsigned char uc_format_q8_8(char* sz_buffer, int i_value, unsigned char uc_decimals);
+
+#endif
@@ -8,6 +8,18 @@
 #include <htc.h>
 #include "system.h"
 #include "timer1.h"
+#include "uart.h"
+#include "timer0.h"
+#include "skps.h"
+#include "event.h"
+#include "lcd.h"
+#include "adc.h"
+#include "pwm.h"
+#include "ramp.h"
+#include "velocity.h"
+#include "pid.h"
+#include "blreset.h"
+#include "limit.h"
 
 
 
@@ -20,10 +32,58 @@
 *******************************************************************************/
 void interrupt isr(void)
 {
+	// The PWM update first, the earlier pwm_isr runs in the PWM period the less
+	// often it has to leave the duty cycles for the next one. Then the limit
+	// switches, both before the Timer 0 tick that can take a few hundred us.
+	
+	// check if Timer 2 matched PR2, start of a PWM period
+	if ((TMR2IE == 1) && (TMR2IF == 1))
+	{
+		pwm_isr();			// call PWM ISR
+	}
+#if defined (_16F887)
+	// check if a limit switch on RB0 - RB3 changed
+	if ((RBIE == 1) && (RBIF == 1))
+#else
+	// check if limit switch 1 on RB0/INT closed
+	if ((INTE == 1) && (INTF == 1))
+#endif
+	{
+		limit_isr();		// cut the relay of the limit switch
+	}
+	// check if Timer 0 is overflow, 1ms system tick
+	if ((T0IE == 1) && (T0IF == 1))
+	{
+		timer0_isr();		// call timer 0 ISR
+		skps_poll_tick();	// time out SKPS poller
+		event_tick();		// sample SW1 and SW2
+		lcd_tick();			// write the LCD shadow to the LCD
+		adc_tick();			// start the ADC scan
+		ramp_tick();		// move the motor speed to its target
+		velocity_tick();	// time the encoder counts
+		blreset_tick();		// time the brushless driver reset
+		limit_tick();		// check the limit switches without interrupt
+	}
 	// check if Timer 1 is overflow
 	if (TMR1IF == 1) 
 	{		
 		timer1_isr();		// call timer 1 ISR		
 	}
-	// User may develop their own ISR under here
+	// check if UART has received data
+	if ((RCIE == 1) && (RCIF == 1))
+	{
+		uart_rx_isr();		// call UART receive ISR
+		skps_poll_rx();		// let SKPS poller take its reply
+	}
+	// check if UART is ready for the next byte to transmit
+	if ((TXIE == 1) && (TXIF == 1))
+	{
+		uart_tx_isr();		// call UART transmit ISR
+	}
+	// check if ADC conversion is done
+	if ((ADIE == 1) && (ADIF == 1))
+	{
+		adc_isr();			// call ADC ISR
+	}
+	// User may develop their own ISR under here
 }
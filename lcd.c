@@ -7,6 +7,8 @@
 #include <htc.h>
 #include "system.h"
 #include "lcd.h"
+#include "bus.h"
+#include "format.h"
 
 /*******************************************************************************
 On MC40SE, 2x8 LCD is being connected in
@@ -77,6 +79,31 @@ F			Character font				5x7 dots			5x10 dots
 // The DDRAM address corresponding to the second row of the LCD.
 #define ADD_SECOND_ROW			0x40
 
+// Execution time of the LCD commands, in us.
+// The fast profile is the HD44780 datasheet timing with a small margin, the
+// conservative profile also works with controllers running at a slower clock.
+#if defined (LCD_TIMING_FAST)
+#define T_CLEAR_US				1600	// CMD_CLEAR, datasheet 1.52ms
+#define T_HOME_US				1600	// CMD_HOME, datasheet 1.52ms
+#define T_COMMAND_US			40		// DDRAM address set and other commands, datasheet 37us
+#define T_DATA_US				40		// character write, datasheet 37us (+4us)
+#define T_E_PULSE_NS			450		// E pulse width, datasheet 230ns
+#define NIBBLES_PER_TICK		8		// lcd_tick sends up to 4 bytes every 1ms
+#else
+#define T_CLEAR_US				3000
+#define T_HOME_US				3000
+#define T_COMMAND_US			100
+#define T_DATA_US				100
+#define T_E_PULSE_NS			1000
+#define NIBBLES_PER_TICK		1		// lcd_tick sends 1 nibble every 1ms
+#endif
+
+// E pulse width in instruction cycles, 4 clocks per instruction, at least 1.
+#define E_PULSE_CYCLES			((_XTAL_FREQ / 4000000UL * T_E_PULSE_NS + 999) / 1000)
+
+// Number of 1ms ticks lcd_tick waits after CMD_CLEAR.
+#define CLEAR_WAIT_TICKS		((T_CLEAR_US + 999) / 1000)
+
 /*******************************************************************************
 * PRIVATE GLOBAL VARIABLES                                                     *
 *******************************************************************************/
@@ -85,14 +112,36 @@ F			Character font				5x7 dots			5x10 dots
 // 1 = 4 bits, 0 = 8 bits.
 unsigned char b_4_bits_data_bus = 1;
 
+// Shadow of the LCD display, written by the public functions.
+unsigned char uc_shadow[2][LCD_COLUMNS];
+unsigned char uc_cursor_row = 0;			// cursor of the shadow
+unsigned char uc_cursor_col = 0;
+
+// What the LCD is showing now, owned by lcd_tick. A cell is dirty when the
+// shadow and the glass are different.
+unsigned char uc_glass[2][LCD_COLUMNS];
+
+// Request to lcd_tick, set by lcd_clr.
+volatile unsigned char b_clear_pending = 0;			// 1 = the whole shadow was blanked
+
+// State of the background update, owned by lcd_tick.
+volatile unsigned char b_lcd_ready = 0;				// 1 = lcd_init is done
+volatile unsigned char uc_tick_wait = 0;			// ticks to wait before next nibble
+volatile unsigned char uc_tick_nibble = 0;			// nibbles of uc_tick_byte left to send
+unsigned char uc_tick_byte = 0;						// byte being sent
+unsigned char b_tick_rs = 0;						// RS of the byte being sent
+unsigned char uc_addr_row = 0;						// DDRAM address of the LCD, the cell
+unsigned char uc_addr_col = 0;						// the next character goes to
+
 /*******************************************************************************
 * PRIVATE FUNCTION PROTOTYPES                                                  *
 *******************************************************************************/
 
 void send_lcd_data(unsigned char b_rs, unsigned char uc_data);
 void set_lcd_e(unsigned char b_output);
-void set_lcd_rs(unsigned char b_output);
-void set_lcd_data(unsigned char uc_data);
+void pulse_lcd_e(void);
+unsigned char uc_lcd_next_byte(void);
+unsigned char uc_lcd_cost(unsigned char b_after_clear);
 
 
 
@@ -111,6 +160,11 @@ void set_lcd_data(unsigned char uc_data);
 *******************************************************************************/
 void lcd_init(void)
 {
+	unsigned char uc_col;
+	
+	// Stop the background update while we talk to the LCD directly.
+	b_lcd_ready = 0;
+	
 	// Set the LCD E pin and wait for the LCD to be ready before we
 	// start sending data to it.
 	set_lcd_e(1);
@@ -119,9 +173,12 @@ void lcd_init(void)
 	// Configure the Function Set of the LCD.	
 	// Because of the LCD is initialized as 8-bit mode during start up, we need
 	// to send the data in 8-bit mode to configure the LCD.
+	// The first two need longer than the usual command time.
 	b_4_bits_data_bus = 0;	//8-bit mode
 	send_lcd_data(0, CMD_FUNCTION_SET | MSK_DL_8 | MSK_N | MSK_F );
+	__delay_ms(5);			// datasheet 4.1ms
 	send_lcd_data(0, CMD_FUNCTION_SET | MSK_DL_8 | MSK_N | MSK_F );
+	__delay_us(100);		// datasheet 100us
 	send_lcd_data(0, CMD_FUNCTION_SET | MSK_DL_8 | MSK_N | MSK_F );	
 	
 	send_lcd_data(0, CMD_FUNCTION_SET | MSK_DL_4 | MSK_N | MSK_F);	// configure in 4 bit mode
@@ -135,7 +192,23 @@ void lcd_init(void)
 	send_lcd_data(0, CMD_DISPLAY_CONTROL | MSK_D | MSK_C | MSK_B);
 	
 	// Clear the LCD display.
-	lcd_clr();
+	send_lcd_data(0, CMD_CLEAR);
+	
+	// Start with a blank shadow, same as the LCD.
+	for (uc_col = 0; uc_col < LCD_COLUMNS; uc_col++) {
+		uc_shadow[0][uc_col] = ' ';
+		uc_shadow[1][uc_col] = ' ';
+		uc_glass[0][uc_col] = ' ';
+		uc_glass[1][uc_col] = ' ';
+	}
+	uc_cursor_row = 0;
+	uc_cursor_col = 0;
+	uc_addr_row = 0;
+	uc_addr_col = 0;
+	b_clear_pending = 0;
+	uc_tick_wait = 0;
+	uc_tick_nibble = 0;
+	b_lcd_ready = 1;
 }
 
 
@@ -155,8 +228,17 @@ void lcd_init(void)
 *******************************************************************************/
 void lcd_clr(void)
 {
-	// Send the command to clear the LCD display.
-	send_lcd_data(0, CMD_CLEAR);
+	unsigned char uc_col;
+	
+	// Blank the shadow, lcd_tick decides whether CMD_CLEAR or writing the
+	// changed cells is faster.
+	for (uc_col = 0; uc_col < LCD_COLUMNS; uc_col++) {
+		uc_shadow[0][uc_col] = ' ';
+		uc_shadow[1][uc_col] = ' ';
+	}
+	b_clear_pending = 1;
+	
+	lcd_home();
 }
 
 
@@ -176,8 +258,9 @@ void lcd_clr(void)
 *******************************************************************************/
 void lcd_home(void)
 {
-	// Send the command to return the cursor to the home position.
-	send_lcd_data(0, CMD_HOME);
+	// Return the cursor of the shadow to the home position.
+	uc_cursor_row = 0;
+	uc_cursor_col = 0;
 }
 
 
@@ -197,8 +280,9 @@ void lcd_home(void)
 *******************************************************************************/
 void lcd_2ndline(void)
 {
-	// Send the command to jump to the second row.
-	send_lcd_data(0, CMD_SET_DDRAM_ADDRESS | ADD_SECOND_ROW);
+	// Move the cursor of the shadow to the second row.
+	uc_cursor_row = 1;
+	uc_cursor_col = 0;
 }
 
 
@@ -218,8 +302,9 @@ void lcd_2ndline(void)
 *******************************************************************************/
 void lcd_goto(unsigned char uc_position)
 {
-	// Send the command to jump to the defined position.
-	send_lcd_data(0, CMD_SET_DDRAM_ADDRESS | uc_position);
+	// Position is the DDRAM address, 0x00 for the first row, 0x40 for the second row.
+	uc_cursor_row = (uc_position & ADD_SECOND_ROW) ? 1 : 0;
+	uc_cursor_col = uc_position & (ADD_SECOND_ROW - 1);
 }
 
 
@@ -239,8 +324,11 @@ void lcd_goto(unsigned char uc_position)
 *******************************************************************************/
 void lcd_putchar(char c_data)
 {
-	// Send the data to display.
-	send_lcd_data(1, (unsigned char)c_data);
+	// Characters beyond the last column are not visible, same as the LCD.
+	if (uc_cursor_col < LCD_COLUMNS) {
+		uc_shadow[uc_cursor_row][uc_cursor_col] = (unsigned char)c_data;
+	}
+	uc_cursor_col++;
 }
 
 
@@ -293,22 +381,14 @@ void lcd_putstr(const char* csz_string)
 *******************************************************************************/
 void lcd_bcd(unsigned char uc_digit, unsigned int ui_number)
 {
-	unsigned int ui_decimal[5] ={ 0 };
-	//extract 5 single digit from ui_number
-		ui_decimal[4] = ui_number/10000;	// obtain the largest single digit, digit4 
-		ui_decimal[3] = ui_number%10000;	// obtain the remainder 
-		ui_decimal[2] = ui_decimal[3]%1000;			
-		ui_decimal[3] = ui_decimal[3]/1000;			// obtain the 2nd largest single digit, digit3 
-		ui_decimal[1] = ui_decimal[2]%100;
-		ui_decimal[2] = ui_decimal[2]/100;			// obtain the 3rd largest single digit, digit2 
-		ui_decimal[0] = ui_decimal[1]%10;			// obtain the smallest single digit, digit0 
-		ui_decimal[1] = ui_decimal[1]/10;			// obtain the 4th largest single digit, digit1 
-		
-		if (uc_digit > 5) uc_digit = 5;			// limit to 5 digits only
-		for( ; uc_digit > 0; uc_digit--)
-		{
-			lcd_putchar(ui_decimal[uc_digit - 1] + 0x30);			
-		}
+	char sz_number[FORMAT_BUFFER_SIZE];
+	
+	if (uc_digit == 0) return;
+	if (uc_digit > 5) uc_digit = 5;			// limit to 5 digits only
+	
+	// the lowest uc_digit digits, with leading zeros
+	uc_format_uint(sz_number, ui_number, uc_digit, '0');
+	lcd_putstr(sz_number);
 }
 
 /*******************************************************************************
@@ -330,6 +410,235 @@ void lcd_clear_msg(const char* csz_string)
 	lcd_putstr(csz_string);
 }
 
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_lcd_busy
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ 1 if the LCD shadow is not yet fully written to the LCD, else 0
+*
+* DESCRIPTIONS:
+* Check whether the background update of the LCD is still in progress.
+*
+*******************************************************************************/
+unsigned char uc_lcd_busy(void)
+{
+	unsigned char uc_col;
+	
+	if ((b_clear_pending == 1) || (uc_tick_nibble != 0) || (uc_tick_wait != 0)) {
+		return 1;
+	}
+	
+	// Any cell not yet on the glass?
+	for (uc_col = 0; uc_col < LCD_COLUMNS; uc_col++) {
+		if (uc_shadow[0][uc_col] != uc_glass[0][uc_col]) return 1;
+		if (uc_shadow[1][uc_col] != uc_glass[1][uc_col]) return 1;
+	}
+	return 0;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: lcd_flush
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Wait until the LCD shows everything written to the LCD shadow.
+*
+*******************************************************************************/
+void lcd_flush(void)
+{
+	while (uc_lcd_busy() == 1) continue;
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for LCD, 1ms tick
+*
+* DESCRIPTIONS:
+* Write up to NIBBLES_PER_TICK nibbles of the LCD shadow to the LCD. The LCD
+* shares PORTD with the relay latch, nothing is written in a tick that main
+* code has the bus.
+* Call after timer0_isr.
+*
+*******************************************************************************/
+void lcd_tick(void)
+{
+	unsigned char uc_nibbles = NIBBLES_PER_TICK;
+	unsigned char b_byte_done = 0;
+	unsigned char b_last_rs;
+	
+	if (b_lcd_ready == 0) return;
+	
+	// Give the LCD time to finish a slow command.
+	if (uc_tick_wait != 0) {
+		uc_tick_wait--;
+		return;
+	}
+	
+	// Main code is using PORTD, try again in the next tick.
+	if (uc_bus_tick_acquire(BUS_LCD) == 0) return;
+	
+	do {
+		// Take the next byte when both nibbles of the last one are sent.
+		if (uc_tick_nibble == 0) {
+			b_last_rs = b_tick_rs;
+			if (uc_lcd_next_byte() == 0) break;
+			
+			// A byte was sent in this tick, let the LCD execute it before the
+			// next one. The next tick is late enough if there is none.
+			if (b_byte_done == 1) {
+				if (b_last_rs == 1) __delay_us(T_DATA_US);
+				else __delay_us(T_COMMAND_US);
+			}
+			uc_tick_nibble = 2;
+		}
+		
+		// Send bit 4 - 7 first, then bit 0 - 3, with a negative e pulse.
+		if (uc_tick_nibble == 2) {
+			bus_tick_lcd_put(b_tick_rs, uc_tick_byte);
+		}
+		else {
+			bus_tick_lcd_put(b_tick_rs, uc_tick_byte << 4);
+		}
+		LCD_E = 0;
+		_delay(E_PULSE_CYCLES);
+		LCD_E = 1;
+		
+		if (--uc_tick_nibble == 0) {
+			// CMD_CLEAR takes more than a tick, wait for it in the next ticks.
+			if ((b_tick_rs == 0) && (uc_tick_byte == CMD_CLEAR)) {
+				uc_tick_wait = CLEAR_WAIT_TICKS;
+				break;
+			}
+			b_byte_done = 1;
+		}
+	} while (--uc_nibbles != 0);
+	bus_tick_release();
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: uc_lcd_next_byte
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ 1 if uc_tick_byte and b_tick_rs hold a new byte to send, 0 if nothing to send
+*
+* DESCRIPTIONS:
+* Pick the next byte for lcd_tick. Only the cells where the shadow and the glass
+* are different are written. The search starts at the DDRAM address of the LCD,
+* so a run of changed cells is written after one DDRAM address. The glass is
+* updated when the character is taken, so a change made after that makes the
+* cell dirty again.
+*
+*******************************************************************************/
+unsigned char uc_lcd_next_byte(void)
+{
+	unsigned char uc_row = uc_addr_row;
+	unsigned char uc_col = uc_addr_col;
+	unsigned char uc_count;
+	
+	// After lcd_clr, send CMD_CLEAR only if it is faster than writing the
+	// changed cells. CMD_CLEAR costs its 2 nibbles and the wait, a tick of
+	// wait could have sent NIBBLES_PER_TICK nibbles.
+	if (b_clear_pending == 1) {
+		b_clear_pending = 0;
+		if (2 + CLEAR_WAIT_TICKS * NIBBLES_PER_TICK + (uc_lcd_cost(1) << 1) < (uc_lcd_cost(0) << 1)) {
+			for (uc_col = 0; uc_col < LCD_COLUMNS; uc_col++) {
+				uc_glass[0][uc_col] = ' ';
+				uc_glass[1][uc_col] = ' ';
+			}
+			uc_addr_row = 0;
+			uc_addr_col = 0;
+			b_tick_rs = 0;
+			uc_tick_byte = CMD_CLEAR;
+			return 1;
+		}
+	}
+	
+	// Look for a dirty cell, starting from the DDRAM address of the LCD.
+	for (uc_count = 0; uc_count < 2 * LCD_COLUMNS; uc_count++) {
+		if (uc_col >= LCD_COLUMNS) {
+			uc_col = 0;
+			uc_row ^= 1;
+		}
+		if (uc_shadow[uc_row][uc_col] != uc_glass[uc_row][uc_col]) break;
+		uc_col++;
+	}
+	if (uc_count == 2 * LCD_COLUMNS) return 0;
+	
+	// The LCD is already at this cell, write the character.
+	if ((uc_row == uc_addr_row) && (uc_col == uc_addr_col)) {
+		b_tick_rs = 1;
+		uc_tick_byte = uc_shadow[uc_row][uc_col];
+		uc_glass[uc_row][uc_col] = uc_tick_byte;
+		uc_addr_col++;
+		return 1;
+	}
+	
+	// Else move the DDRAM address to it first.
+	uc_addr_row = uc_row;
+	uc_addr_col = uc_col;
+	b_tick_rs = 0;
+	uc_tick_byte = CMD_SET_DDRAM_ADDRESS | (uc_row ? ADD_SECOND_ROW : 0) | uc_col;
+	return 1;
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: uc_lcd_cost
+*
+* PARAMETERS:
+* ~ b_after_clear	- 1 to count from a cleared LCD, 0 to count from the glass
+*
+* RETURN:
+* ~ Number of bytes to send to make the LCD show the shadow
+*
+* DESCRIPTIONS:
+* Count the changed cells, plus one DDRAM address for every run of them.
+*
+*******************************************************************************/
+unsigned char uc_lcd_cost(unsigned char b_after_clear)
+{
+	unsigned char uc_row;
+	unsigned char uc_col;
+	unsigned char uc_glass_char;
+	unsigned char b_in_run;
+	unsigned char uc_cost = 0;
+	
+	for (uc_row = 0; uc_row < 2; uc_row++) {
+		b_in_run = 0;
+		for (uc_col = 0; uc_col < LCD_COLUMNS; uc_col++) {
+			uc_glass_char = b_after_clear ? ' ' : uc_glass[uc_row][uc_col];
+			if (uc_shadow[uc_row][uc_col] == uc_glass_char) {
+				b_in_run = 0;
+			}
+			else {
+				if (b_in_run == 0) uc_cost++;	// DDRAM address
+				uc_cost++;
+				b_in_run = 1;
+			}
+		}
+	}
+	return uc_cost;
+}
+
+
+
 /*******************************************************************************
 * PRIVATE FUNCTION: send_lcd_data
 *
@@ -341,49 +650,53 @@ void lcd_clear_msg(const char* csz_string)
 * ~ void
 *
 * DESCRIPTIONS:
-* Set the output of the LCD RS pin and data bus.
+* Set the output of the LCD RS pin and data bus, and wait for the LCD to
+* execute the command or write the character.
 *
 *******************************************************************************/
 void send_lcd_data(unsigned char b_rs, unsigned char uc_data)
 {
-		unsigned char uc_pre_portd = 0;	// variable to store original PORTD value
-		uc_pre_portd = PORTD;			//keep PORTD original value
+		// PORTD is shared with the relay latch, only main code uses it here.
+		while (uc_bus_acquire(BUS_LCD) == 0) continue;
+		
 		// 4-bit Mode.
 		// We need to send the data nibble by nibble.
 		// start with bit 4 - 7
 		if (b_4_bits_data_bus == 1) {
-		set_lcd_rs(b_rs);
-		set_lcd_data(uc_data & 0xF0);
+		bus_lcd_put(b_rs, uc_data);
 		
 		// Send a negative e pulse.
-		set_lcd_e(0);
-		__delay_ms(2);
-		set_lcd_e(1);
-		__delay_ms(1);
+		pulse_lcd_e();
 		
 		// Then we send bit 0 - 3.
-		set_lcd_rs(b_rs);
-		set_lcd_data(uc_data << 4);
+		bus_lcd_put(b_rs, uc_data << 4);
 		
 		// Send another negative e pulse.
-		set_lcd_e(0);
-		__delay_ms(2);
-		set_lcd_e(1);
-		__delay_ms(1);
+		pulse_lcd_e();
 		}	
 		else {
 		// 8-bit Mode.
 		// We only need to send the data once.
-		set_lcd_rs(b_rs);
-		set_lcd_data(uc_data);
+		bus_lcd_put(b_rs, uc_data);
 		
 		// Send a negative e pulse.
-		set_lcd_e(0);
-		__delay_ms(2);
-		set_lcd_e(1);
-		__delay_ms(1);
+		pulse_lcd_e();
 	}	
-	PORTD = uc_pre_portd; //restore PORTD original value
+	bus_release(BUS_LCD);
+	
+	// Wait for the LCD to execute it.
+	if (b_rs == 1) {
+		__delay_us(T_DATA_US);
+	}
+	else if (uc_data == CMD_CLEAR) {
+		__delay_us(T_CLEAR_US);
+	}
+	else if ((uc_data & 0xFE) == CMD_HOME) {
+		__delay_us(T_HOME_US);
+	}
+	else {
+		__delay_us(T_COMMAND_US);
+	}
 }
 
 
@@ -409,39 +722,22 @@ void set_lcd_e(unsigned char b_output)
 
 
 /*******************************************************************************
-* PRIVATE FUNCTION: set_lcd_rs
+* PRIVATE FUNCTION: pulse_lcd_e
 *
 * PARAMETERS:
-* ~ b_output	- The output of the LCD RS pin (1 or 0).
-*
-* RETURN:
 * ~ void
 *
-* DESCRIPTIONS:
-* Set the output of the LCD RS pin.
-*
-*******************************************************************************/
-void set_lcd_rs(unsigned char b_output)
-{
-	LCD_RS = b_output;
-}
-
-
-
-/*******************************************************************************
-* PRIVATE FUNCTION: set_lcd_data
-*
-* PARAMETERS:
-* ~ uc_data	- The output of the LCD data bus.
-*
 * RETURN:
 * ~ void
 *
 * DESCRIPTIONS:
-* Set the output of the LCD data bus.
+* Send a negative pulse on the LCD E pin, the LCD takes the data on the
+* falling edge.
 *
 *******************************************************************************/
-void set_lcd_data(unsigned char uc_data)
+void pulse_lcd_e(void)
 {
-	LCD_DATA = (LCD_DATA & 0x0F) | uc_data;
+	set_lcd_e(0);
+	_delay(E_PULSE_CYCLES);
+	set_lcd_e(1);
 }
@@ -25,7 +25,10 @@
 * ~ void
 *
 * DESCRIPTIONS:
-* Initialize and clear the LCD display.
+* Initialize and clear the LCD display. This function waits for the LCD, the
+* other functions only write the LCD shadow in RAM and lcd_tick copies it to
+* the LCD in the background. Timer 0 must be initialized for the LCD to be
+* updated.
 *
 *******************************************************************************/
 extern void lcd_init(void);
@@ -164,4 +167,51 @@ void lcd_bcd(unsigned char uc_digit, unsigned int ui_number);
 void lcd_clear_msg(const char* csz_string);
 
 
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_lcd_busy
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ 1 if the LCD shadow is not yet fully written to the LCD, else 0
+*
+* DESCRIPTIONS:
+* Check whether the background update of the LCD is still in progress.
+*
+*******************************************************************************/
+extern unsigned char uc_lcd_busy(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: lcd_flush
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Wait until the LCD shows everything written to the LCD shadow.
+*
+*******************************************************************************/
+extern void lcd_flush(void);
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for LCD, 1ms tick
+*
+* DESCRIPTIONS:
+* Write one nibble of the LCD shadow to the LCD. The LCD shares PORTD with the
+* relay latch, nothing is written in a tick that main code has the bus.
+* Call after timer0_isr.
+*
+*******************************************************************************/
+extern void lcd_tick(void);
+
+
 #endif
@@ -0,0 +1,192 @@
+/*******************************************************************************
+* This file provides the functions for the limit switch cut-off on MC40SE,
+* PIC16F887 or PIC16F877A
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#include <htc.h>
+#include "system.h"
+#include "limit.h"
+#include "bus.h"
+#include "event.h"
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+static volatile unsigned char b_limit_enabled = 0;	// 1 = limit_init is done
+static volatile unsigned char uc_limit_state = 0;	// closed switches, bit 0 = LIMIT1
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION PROTOTYPES                                                  *
+*******************************************************************************/
+
+unsigned char uc_limit_read(void);
+void limit_update(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: limit_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Start the cut-off and enable the limit switch interrupt. Call after adc_init,
+* RB0 - RB3 must be digital inputs, and after relay_init.
+*
+*******************************************************************************/
+void limit_init(void)
+{
+#if defined (_16F887)
+	unsigned char uc_dummy;
+#endif
+	
+	// A switch closed at start up is also a cut-off, the next tick takes it.
+	GIE = 0;
+	uc_limit_state = 0;
+	b_limit_enabled = 1;
+	
+#if defined (_16F887)
+	IOCB = IOCB | 0b00001111;	// change interrupt on RB0 - RB3
+	uc_dummy = PORTB;			// end the mismatch before clearing the flag
+	RBIF = 0;
+	RBIE = 1;
+#else
+	INTEDG = 0;					// RB0/INT on the falling edge, LIMIT1 closing
+	INTF = 0;
+	INTE = 1;
+#endif
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_limit_closed
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Closed limit switches, bit 0 is LIMIT1.
+*
+* DESCRIPTIONS:
+* Read the limit switches as last seen by the ISR. This function does not
+* block.
+*
+*******************************************************************************/
+unsigned char uc_limit_closed(void)
+{
+	return uc_limit_state;
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for the limit switches
+*
+* DESCRIPTIONS:
+* This is the ISR for the PORTB change interrupt (PIC16F887) or the RB0/INT
+* interrupt (PIC16F877A), it cuts the relay of a limit switch that closed.
+*
+*******************************************************************************/
+void limit_isr(void)
+{
+#if defined (_16F887)
+	unsigned char uc_dummy;
+	
+	uc_dummy = PORTB;		// end the mismatch before clearing the flag
+	RBIF = 0;
+#else
+	INTF = 0;
+#endif
+	limit_update();
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for the limit switches, 1ms tick
+*
+* DESCRIPTIONS:
+* Check the limit switches that have no interrupt and let go the relays of
+* the limit switches that opened. Call after timer0_isr.
+*
+*******************************************************************************/
+void limit_tick(void)
+{
+	limit_update();
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: uc_limit_read
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ state of LIMIT1 - LIMIT4, bit set = closed
+*
+* DESCRIPTIONS:
+* Read the limit switches, they are active low.
+*
+*******************************************************************************/
+unsigned char uc_limit_read(void)
+{
+	unsigned char uc_state = 0;
+	
+	if (LIMIT1 == 0) uc_state |= 0b00000001;
+	if (LIMIT2 == 0) uc_state |= 0b00000010;
+	if (LIMIT3 == 0) uc_state |= 0b00000100;
+	if (LIMIT4 == 0) uc_state |= 0b00001000;
+	return uc_state;
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: limit_update
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Cut the relays of the closed limit switches, limit switch n cuts latch
+* output n, and queue an event for every switch that has just closed.
+* Called by the ISR only.
+*
+*******************************************************************************/
+void limit_update(void)
+{
+	unsigned char uc_state;
+	unsigned char uc_closing;
+	unsigned char uc_id;
+	
+	if (b_limit_enabled == 0) return;
+	
+	uc_state = uc_limit_read();
+	uc_closing = uc_state & ~uc_limit_state;
+	uc_limit_state = uc_state;
+	
+	bus_tick_latch_cut(uc_state);
+	
+	for (uc_id = EVENT_LIMIT1; uc_closing != 0; uc_id++, uc_closing >>= 1) {
+		if (uc_closing & 1) event_tick_push(uc_id, EVENT_CUTOFF);
+	}
+}
@@ -0,0 +1,85 @@
+/*******************************************************************************
+* This file provides the functions for the limit switch cut-off on MC40SE,
+* PIC16F887 or PIC16F877A
+* Author: Cytron Technologies Sdn. Bhd.
+*
+* LIMIT1 - LIMIT4 (SEN1 - SEN4, RB0 - RB3) cut relay 1 - 4 in the ISR as soon as
+* they close, and hold it off while they are closed. Each cut-off is queued as
+* an EVENT_CUTOFF event from EVENT_LIMIT1 - EVENT_LIMIT4.
+* PIC16F887  : interrupt-on-change on RB0 - RB3.
+* PIC16F877A : RB0/INT for LIMIT1, the change interrupt is only on RB4 - RB7,
+*              so LIMIT2 - LIMIT4 are checked by the 1ms system tick.
+*******************************************************************************/
+
+
+
+#ifndef _LIMIT_H
+#define _LIMIT_H
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION PROTOTYPES                                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* PUBLIC FUNCTION: limit_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Start the cut-off and enable the limit switch interrupt. Call after adc_init,
+* RB0 - RB3 must be digital inputs, and after relay_init.
+*
+*******************************************************************************/
+extern void limit_init(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_limit_closed
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Closed limit switches, bit 0 is LIMIT1.
+*
+* DESCRIPTIONS:
+* Read the limit switches as last seen by the ISR. This function does not
+* block.
+*
+*******************************************************************************/
+extern unsigned char uc_limit_closed(void);
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for the limit switches
+*
+* DESCRIPTIONS:
+* This is the ISR for the PORTB change interrupt (PIC16F887) or the RB0/INT
+* interrupt (PIC16F877A), it cuts the relay of a limit switch that closed.
+*
+*******************************************************************************/
+extern void limit_isr(void);
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for the limit switches, 1ms tick
+*
+* DESCRIPTIONS:
+* Check the limit switches that have no interrupt and let go the relays of
+* the limit switches that opened. Call after timer0_isr.
+*
+*******************************************************************************/
+extern void limit_tick(void);
+
+
+
+#endif
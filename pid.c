@@ -0,0 +1,304 @@
+/*******************************************************************************
+* This file provides the functions for the PID wheel speed controller on
+* MC40SE, the encoder speed closes the loop on the PWM of one motor
+* Author: Cytron Technologies Sdn. Bhd.
+*
+* MC40SE has one encoder input, so there is one loop, on the motor of
+* PID_PWM_CHANNEL. Everything is kept in duty cycle (0 - 1023) with 8 fraction
+* bits.
+*
+* The loop runs once for every speed of velocity_task, so the control period
+* is VELOCITY_WINDOW_MS. The speed is sampled by the ISR at a fixed rate, but
+* velocity_task and pid_task run from the main program, so the new duty cycle
+* is late by the time the main loop takes to get to them. A run of the loop
+* takes 3 multiplies of 16 x 16 bits by l_pid_mul and no divide.
+*******************************************************************************/
+
+
+
+#include <htc.h>
+#include "system.h"
+#include "pid.h"
+#include "pwm.h"
+#include "velocity.h"
+
+
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+#define PID_MAX_SPEED		32767
+
+// Output limit with 8 fraction bits, the highest duty cycle of set_pwm.
+#define PID_OUTPUT_MAX		(1023L << 8)
+
+#if PID_PWM_CHANNEL == 2
+#define PID_PWM_WRITE(duty)	set_pwm2(duty)
+#else
+#define PID_PWM_WRITE(duty)	set_pwm1(duty)
+#endif
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+// 1 = pid_task drives the PWM.
+static unsigned char b_pid_running = 0;
+
+// Gains in duty cycle x 256.
+static unsigned int ui_pid_kp = 0;
+static unsigned int ui_pid_ki = 0;
+static unsigned int ui_pid_kd = 0;
+static unsigned int ui_pid_kff = 0;
+
+// Target.
+static int i_pid_target = 0;			// counts/s
+static long l_pid_feedforward = 0;		// output for the target x 256
+
+// State of the loop, written by pid_task.
+static long l_pid_integral = 0;			// x 256
+static int i_pid_last_speed = 0;		// counts/s
+static unsigned int ui_pid_duty = 0;
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION PROTOTYPES                                                  *
+*******************************************************************************/
+
+long l_pid_mul(unsigned int ui_gain, int i_value);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pid_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Take the gains in system.h, the loop is not running until pid_set_speed.
+* PWM and velocity_init must be done.
+*
+*******************************************************************************/
+void pid_init(void)
+{
+	b_pid_running = 0;
+	pid_set_gains(PID_KP, PID_KI, PID_KD, PID_KFF);
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pid_set_gains
+*
+* PARAMETERS:
+* ~ ui_kp		- Proportional gain, x PID_GAIN_ONE.
+* ~ ui_ki		- Integral gain per VELOCITY_WINDOW_MS, x PID_GAIN_ONE.
+* ~ ui_kd		- Derivative gain per VELOCITY_WINDOW_MS, x PID_GAIN_ONE.
+* ~ ui_kff		- Feed-forward, duty cycle per count/s of the target, x
+*				  PID_GAIN_ONE. 1023 x PID_GAIN_ONE / top speed is a good start.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Change the gains, the integral is cleared.
+*
+*******************************************************************************/
+void pid_set_gains(unsigned int ui_kp, unsigned int ui_ki, unsigned int ui_kd, unsigned int ui_kff)
+{
+	ui_pid_kp = ui_kp;
+	ui_pid_ki = ui_ki;
+	ui_pid_kd = ui_kd;
+	ui_pid_kff = ui_kff;
+	l_pid_feedforward = (long)ui_kff * i_pid_target;
+	l_pid_integral = 0;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pid_set_speed
+*
+* PARAMETERS:
+* ~ ui_speed	- Target speed of the encoder in counts/s, not more than 32767.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the target speed and start the loop, pid_task drives the PWM of
+* PID_PWM_CHANNEL from now on. The direction pin is not changed. This function
+* returns immediately.
+*
+*******************************************************************************/
+void pid_set_speed(unsigned int ui_speed)
+{
+	unsigned long ul_speed;
+	
+	if (ui_speed > PID_MAX_SPEED) ui_speed = PID_MAX_SPEED;
+	i_pid_target = ui_speed;
+	l_pid_feedforward = (long)ui_pid_kff * ui_speed;
+	
+	if (b_pid_running == 0) {
+		// start without a kick from the old state
+		ul_speed = ul_velocity() / VELOCITY_ONE;
+		if (ul_speed > PID_MAX_SPEED) ul_speed = PID_MAX_SPEED;
+		l_pid_integral = 0;
+		i_pid_last_speed = (int)ul_speed;
+		uc_velocity_new();	// the loop starts on the next speed
+		b_pid_running = 1;
+	}
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pid_stop
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Stop the loop and set the duty cycle of PID_PWM_CHANNEL to zero.
+*
+*******************************************************************************/
+void pid_stop(void)
+{
+	b_pid_running = 0;
+	ui_pid_duty = 0;
+	PID_PWM_WRITE(0);
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_pid_output
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Latest duty cycle of the loop, 0 - 1023.
+*
+* DESCRIPTIONS:
+* Get the output of the loop.
+*
+*******************************************************************************/
+unsigned int ui_pid_output(void)
+{
+	return ui_pid_duty;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pid_task
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Run the loop once for every new speed of velocity_task, returns at once in
+* between. Call it from the main loop or as a task of the scheduler, right
+* after velocity_task.
+*
+*******************************************************************************/
+void pid_task(void)
+{
+	unsigned long ul_speed;
+	unsigned int ui_speed;
+	int i_error;
+	long l_output;
+	long l_integral;
+	
+	if (uc_velocity_new() == 0) return;
+	if (b_pid_running == 0) return;
+	
+	ul_speed = ul_velocity() >> 8;	// whole counts/s
+	if (ul_speed > PID_MAX_SPEED) ul_speed = PID_MAX_SPEED;
+	ui_speed = (unsigned int)ul_speed;
+	i_error = i_pid_target - (int)ui_speed;
+	
+	// Feed-forward and proportional.
+	l_output = l_pid_feedforward + l_pid_mul(ui_pid_kp, i_error);
+	
+	// Derivative on the speed, a new target does not kick the output.
+	if (ui_pid_kd != 0) {
+		l_output -= l_pid_mul(ui_pid_kd, (int)ui_speed - i_pid_last_speed);
+	}
+	i_pid_last_speed = ui_speed;
+	
+	// Integral, not taken further while the output is at a limit in the same
+	// direction (anti-windup), and never more than the whole output range.
+	l_integral = l_pid_integral;
+	if (ui_pid_ki != 0) {
+		l_integral += l_pid_mul(ui_pid_ki, i_error);
+		if (l_integral > PID_OUTPUT_MAX) l_integral = PID_OUTPUT_MAX;
+		else if (l_integral < -PID_OUTPUT_MAX) l_integral = -PID_OUTPUT_MAX;
+	}
+	l_output += l_integral;
+	
+	if (l_output > PID_OUTPUT_MAX) {
+		l_output = PID_OUTPUT_MAX;
+		if (i_error < 0) l_pid_integral = l_integral;
+	}
+	else if (l_output < 0) {
+		l_output = 0;
+		if (i_error > 0) l_pid_integral = l_integral;
+	}
+	else {
+		l_pid_integral = l_integral;
+	}
+	
+	ui_pid_duty = (unsigned int)((l_output + 128) >> 8);
+	PID_PWM_WRITE(ui_pid_duty);
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: l_pid_mul
+*
+* PARAMETERS:
+* ~ ui_gain		- Gain x PID_GAIN_ONE.
+* ~ i_value		- Error or change of speed in counts/s.
+*
+* RETURN:
+* ~ ui_gain x i_value.
+*
+* DESCRIPTIONS:
+* Multiply 16 x 16 bits to 32 bits, shift and add on the bits of the gain, at
+* most 16 steps. The long multiply of the compiler takes 32 steps.
+*
+*******************************************************************************/
+long l_pid_mul(unsigned int ui_gain, int i_value)
+{
+	unsigned long ul_value;
+	unsigned long ul_product = 0;
+	
+	if (i_value < 0) ul_value = (unsigned int)0 - (unsigned int)i_value;
+	else ul_value = (unsigned int)i_value;
+	
+	while (ui_gain != 0) {
+		if ((ui_gain & 1) != 0) ul_product += ul_value;
+		ul_value <<= 1;
+		ui_gain >>= 1;
+	}
+	
+	if (i_value < 0) return -(long)ul_product;
+	return (long)ul_product;
+}
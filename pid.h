@@ -0,0 +1,130 @@
+/*******************************************************************************
+* This file provides the functions for the PID wheel speed controller on
+* MC40SE, the encoder speed closes the loop on the PWM of one motor
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#ifndef _PID_H
+#define _PID_H
+
+// Gains are in duty cycle (0 - 1023) per count/s with 8 fraction bits, 256 = 1.
+#define PID_GAIN_ONE		256
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION PROTOTYPES                                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pid_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Take the gains in system.h, the loop is not running until pid_set_speed.
+* PWM and velocity_init must be done.
+*
+*******************************************************************************/
+extern void pid_init(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pid_set_gains
+*
+* PARAMETERS:
+* ~ ui_kp		- Proportional gain, x PID_GAIN_ONE.
+* ~ ui_ki		- Integral gain per VELOCITY_WINDOW_MS, x PID_GAIN_ONE.
+* ~ ui_kd		- Derivative gain per VELOCITY_WINDOW_MS, x PID_GAIN_ONE.
+* ~ ui_kff		- Feed-forward, duty cycle per count/s of the target, x
+*				  PID_GAIN_ONE. 1023 x PID_GAIN_ONE / top speed is a good start.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Change the gains, the integral is cleared.
+*
+*******************************************************************************/
+extern void pid_set_gains(unsigned int ui_kp, unsigned int ui_ki, unsigned int ui_kd, unsigned int ui_kff);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pid_set_speed
+*
+* PARAMETERS:
+* ~ ui_speed	- Target speed of the encoder in counts/s, not more than 32767.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the target speed and start the loop, pid_task drives the PWM of
+* PID_PWM_CHANNEL from now on. The direction pin is not changed. This function
+* returns immediately.
+*
+*******************************************************************************/
+extern void pid_set_speed(unsigned int ui_speed);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pid_stop
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Stop the loop and set the duty cycle of PID_PWM_CHANNEL to zero.
+*
+*******************************************************************************/
+extern void pid_stop(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_pid_output
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Latest duty cycle of the loop, 0 - 1023.
+*
+* DESCRIPTIONS:
+* Get the output of the loop.
+*
+*******************************************************************************/
+extern unsigned int ui_pid_output(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pid_task
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Run the loop once for every new speed of velocity_task, returns at once in
+* between. Call it from the main loop or as a task of the scheduler, right
+* after velocity_task.
+*
+*******************************************************************************/
+extern void pid_task(void);
+
+#endif
@@ -12,6 +12,45 @@
 
 
 
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+// Ask pwm_isr to write the duty cycles at the next match of Timer 2. The flag
+// is cleared first, so the write does not happen in the middle of a period.
+// A macro, it is used by both the main program and pwm_tick_set1 and pwm_tick_set2 in the ISR.
+#define PWM_COMMIT()		do {\
+								if (TMR2IE == 0) { TMR2IF = 0; TMR2IE = 1; }\
+							} while (0)
+
+// Split a duty cycle in counts into the CCPRxL byte and the DCxB bits of
+// CCPxCON, so pwm_isr only copies them.
+#define PWM_STAGE(uc_ccprl, uc_dcb, counts)	do {\
+								(uc_ccprl) = (unsigned char)((counts) >> 2);\
+								(uc_dcb) = (unsigned char)((counts) << 4) & 0b00110000;\
+							} while (0)
+
+// pwm_isr writes the duty cycles only if Timer 2 is at or below this count,
+// so the writes, about PWM_WRITE_CYCLES instruction cycles, end before the
+// next match.
+#define PWM_WRITE_CYCLES	20
+#define PWM_PRESCALE		(1 << (2 * PWM_T2CKPS))
+#define PWM_LAST_WRITE		(PWM_PR2 - (PWM_WRITE_CYCLES + PWM_PRESCALE - 1) / PWM_PRESCALE)
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+// Duty cycles waiting for the start of the next PWM period, see PWM_STAGE.
+unsigned char uc_pwm1_ccprl = 0;
+unsigned char uc_pwm1_dcb = 0;
+unsigned char uc_pwm2_ccprl = 0;
+unsigned char uc_pwm2_dcb = 0;
+
+
+
 /*******************************************************************************
 * PUBLIC FUNCTION: pwm_init
 *
@@ -27,10 +66,10 @@
 *******************************************************************************/
 void pwm_init(void)
 {
-	// Setting PWM frequency = 4.90KHz at 8MHz OSC Freq
-	PR2 = 0xFF;
-	T2CKPS1 = 0;
-	T2CKPS0 = 1;	// Timer 2 prescale = 4.
+	// Setting PWM frequency of the profile selected in system.h
+	PR2 = PWM_PR2;
+	T2CKPS1 = (PWM_T2CKPS >> 1) & 1;
+	T2CKPS0 = PWM_T2CKPS & 1;	// Timer 2 prescale = 1, 4 or 16.
 	
 	CCPR1L = 0;		// Duty cycle = 0;
 	CCPR2L = 0;		// Duty cycle = 0;
@@ -75,6 +114,11 @@ void pwm_init(void)
 	CCP2M1 = 0;
 	CCP2M0 = 0;	
 #endif
+	
+	// Timer 2 interrupt is only used when there is a new duty cycle.
+	TMR2IE = 0;
+	PEIE = 1;
+	GIE = 1;
 }	
 
 
@@ -94,8 +138,12 @@ void pwm_init(void)
 *******************************************************************************/
 void set_pwm1(unsigned int ui_duty_cycle)
 {
-	CCP1CON = (CCP1CON & 0b11001111) | (0b00110000 & ((unsigned char)(ui_duty_cycle << 4)));
-	CCPR1L = ui_duty_cycle >> 2;
+	ui_duty_cycle = PWM_SCALE(ui_duty_cycle);
+	
+	GIE = 0;
+	PWM_STAGE(uc_pwm1_ccprl, uc_pwm1_dcb, ui_duty_cycle);
+	PWM_COMMIT();
+	GIE = 1;
 }	
 
 /*******************************************************************************
@@ -113,6 +161,109 @@ void set_pwm1(unsigned int ui_duty_cycle)
 *******************************************************************************/
 void set_pwm2(unsigned int ui_duty_cycle)
 {
-	CCP2CON = (CCP2CON & 0b11001111) | (0b00110000 & ((unsigned char)(ui_duty_cycle << 4)));
-	CCPR2L = ui_duty_cycle >> 2;
+	ui_duty_cycle = PWM_SCALE(ui_duty_cycle);
+	
+	GIE = 0;
+	PWM_STAGE(uc_pwm2_ccprl, uc_pwm2_dcb, ui_duty_cycle);
+	PWM_COMMIT();
+	GIE = 1;
 }	
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: set_pwm
+*
+* PARAMETERS:
+* ~ ui_duty_cycle1	- The duty cycle of the PWM1 in 16-bit, 10-bit significant.
+* ~ ui_duty_cycle2	- The duty cycle of the PWM2 in 16-bit, 10-bit significant.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the duty cycle of both PWM together, at the start of the next PWM period.
+*
+*******************************************************************************/
+void set_pwm(unsigned int ui_duty_cycle1, unsigned int ui_duty_cycle2)
+{
+	ui_duty_cycle1 = PWM_SCALE(ui_duty_cycle1);
+	ui_duty_cycle2 = PWM_SCALE(ui_duty_cycle2);
+	
+	GIE = 0;	// pwm_isr must not take one new and one old duty cycle
+	PWM_STAGE(uc_pwm1_ccprl, uc_pwm1_dcb, ui_duty_cycle1);
+	PWM_STAGE(uc_pwm2_ccprl, uc_pwm2_dcb, ui_duty_cycle2);
+	PWM_COMMIT();
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pwm_tick_set1
+*
+* PARAMETERS:
+* ~ ui_counts		- The duty cycle of the PWM1, already rescaled by PWM_SCALE.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Same as set_pwm1 for a duty cycle already rescaled, without touching GIE.
+* Call from the ISR only.
+*
+*******************************************************************************/
+void pwm_tick_set1(unsigned int ui_counts)
+{
+	PWM_STAGE(uc_pwm1_ccprl, uc_pwm1_dcb, ui_counts);
+	PWM_COMMIT();
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pwm_tick_set2
+*
+* PARAMETERS:
+* ~ ui_counts		- The duty cycle of the PWM2, already rescaled by PWM_SCALE.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Same as set_pwm2 for a duty cycle already rescaled, without touching GIE.
+* Call from the ISR only.
+*
+*******************************************************************************/
+void pwm_tick_set2(unsigned int ui_counts)
+{
+	PWM_STAGE(uc_pwm2_ccprl, uc_pwm2_dcb, ui_counts);
+	PWM_COMMIT();
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for PWM
+*
+* DESCRIPTIONS:
+* Timer 2 matched PR2, a new PWM period has started. Write the new duty cycles
+* of both channels, they are taken by the CCP modules at the start of the
+* following period. If the interrupt is served too close to the next match to
+* write both channels, they are written after that match instead. A late
+* interrupt delays the new duty cycles by a period, it never splits them.
+*
+*******************************************************************************/
+void pwm_isr(void)
+{
+	TMR2IF = 0;
+	
+	// Too close to the next match, try again after it.
+	if (TMR2 > PWM_LAST_WRITE) return;
+	
+	CCPR1L = uc_pwm1_ccprl;
+	CCP1CON = (CCP1CON & 0b11001111) | uc_pwm1_dcb;
+	CCPR2L = uc_pwm2_ccprl;
+	CCP2CON = (CCP2CON & 0b11001111) | uc_pwm2_dcb;
+	TMR2IE = 0;		// nothing more to write
+}
@@ -9,6 +9,48 @@
 #ifndef _PWM_H
 #define _PWM_H
 
+// PWM frequency of the profile in system.h.
+#if defined (PWM_PROFILE_SILENT)
+#define PWM_FREQUENCY		19500
+#elif defined (PWM_PROFILE_STANDARD)
+#define PWM_FREQUENCY		4900
+#elif defined (PWM_PROFILE_LOW)
+#define PWM_FREQUENCY		1000
+#else
+#define PWM_FREQUENCY		(_XTAL_FREQ / (4UL * 4 * 256))	// legacy, 1.95kHz at 8MHz, 4.9kHz at 20MHz
+#endif
+
+// PWM frequency = _XTAL_FREQ / (4 x prescale x (PR2 + 1)). The legacy profile
+// is the original setting, prescale 4 and PR2 = 0xFF with 10-bit duty cycle.
+// Other profiles use the smallest Timer 2 prescaler that fits PR2 in 8 bits,
+// a smaller prescaler gives more duty cycle resolution.
+#define PWM_PERIOD(pre)		((_XTAL_FREQ / (4UL * (pre)) + PWM_FREQUENCY / 2) / PWM_FREQUENCY)
+#if !defined (PWM_PROFILE_SILENT) && !defined (PWM_PROFILE_STANDARD) && !defined (PWM_PROFILE_LOW)
+#define PWM_T2CKPS			0b01		// prescale 4
+#define PWM_PR2				255
+#elif PWM_PERIOD(1) <= 256
+#define PWM_T2CKPS			0b00		// prescale 1
+#define PWM_PR2				(PWM_PERIOD(1) - 1)
+#elif PWM_PERIOD(4) <= 256
+#define PWM_T2CKPS			0b01		// prescale 4
+#define PWM_PR2				(PWM_PERIOD(4) - 1)
+#elif PWM_PERIOD(16) <= 256
+#define PWM_T2CKPS			0b10		// prescale 16
+#define PWM_PR2				(PWM_PERIOD(16) - 1)
+#else
+#define PWM_T2CKPS			0b10		// prescale 16, lowest frequency possible
+#define PWM_PR2				255
+#endif
+
+// Duty cycle register value for 100%, 4 x (PR2 + 1). The 0 - 1023 duty cycle
+// of the callers is rescaled to it, 1024 means 10 bits and no rescale.
+#define PWM_DUTY_FULL		(4UL * (PWM_PR2 + 1))
+#if PWM_DUTY_FULL == 1024
+#define PWM_SCALE(duty)		(duty)
+#else
+#define PWM_SCALE(duty)		((unsigned int)(((unsigned long)(duty) * PWM_DUTY_FULL + 512) >> 10))
+#endif
+
 
 
 /*******************************************************************************
@@ -25,7 +67,8 @@
 * ~ void
 *
 * DESCRIPTIONS:
-* Initialize the CCP1 module to operate in PWM mode.
+* Initialize the CCP1 and CCP2 module to operate in PWM mode, at the frequency
+* of the PWM profile in system.h.
 *
 *******************************************************************************/
 extern void pwm_init(void);
@@ -36,13 +79,15 @@ extern void pwm_init(void);
 * PUBLIC FUNCTION: set_pwm1
 *
 * PARAMETERS:
-* ~ ui_duty_cycle	- The duty cycle of the PWM1 in 16-bit, 10-bit significant.
+* ~ ui_duty_cycle	- The duty cycle of the PWM1, 0 - 1023.
 *
 * RETURN:
 * ~ void
 *
 * DESCRIPTIONS:
-* Set the duty cycle of the PWM1.
+* Set the duty cycle of the PWM1. The new duty cycle is written at the start of
+* the next PWM period, see set_pwm. The duty cycle is rescaled to the
+* resolution of the PWM profile.
 *
 *******************************************************************************/
 extern void set_pwm1(unsigned int ui_duty_cycle);
@@ -53,15 +98,89 @@ extern void set_pwm1(unsigned int ui_duty_cycle);
 * PUBLIC FUNCTION: set_pwm2
 *
 * PARAMETERS:
-* ~ ui_duty_cycle	- The duty cycle of the PWM2 in 16-bit, 10-bit significant.
+* ~ ui_duty_cycle	- The duty cycle of the PWM2, 0 - 1023.
 *
 * RETURN:
 * ~ void
 *
 * DESCRIPTIONS:
-* Set the duty cycle of the PWM2.
+* Set the duty cycle of the PWM2. The new duty cycle is written at the start of
+* the next PWM period, see set_pwm. The duty cycle is rescaled to the
+* resolution of the PWM profile.
 *
 *******************************************************************************/
 extern void set_pwm2(unsigned int ui_duty_cycle);
 
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: set_pwm
+*
+* PARAMETERS:
+* ~ ui_duty_cycle1	- The duty cycle of the PWM1, 0 - 1023.
+* ~ ui_duty_cycle2	- The duty cycle of the PWM2, 0 - 1023.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the duty cycle of both PWM together. The duty cycles are kept and
+* written by pwm_isr at the start of the next PWM period, so both channels
+* change on the same PWM edge and the 2 LSB and 8 MSB of a channel can not be
+* taken in different periods. This function returns immediately.
+*
+*******************************************************************************/
+extern void set_pwm(unsigned int ui_duty_cycle1, unsigned int ui_duty_cycle2);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pwm_tick_set1
+*
+* PARAMETERS:
+* ~ ui_counts		- The duty cycle of the PWM1, already rescaled by PWM_SCALE.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Same as set_pwm1 for a duty cycle already rescaled, without touching GIE.
+* Call from the ISR only.
+*
+*******************************************************************************/
+extern void pwm_tick_set1(unsigned int ui_counts);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: pwm_tick_set2
+*
+* PARAMETERS:
+* ~ ui_counts		- The duty cycle of the PWM2, already rescaled by PWM_SCALE.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Same as set_pwm2 for a duty cycle already rescaled, without touching GIE.
+* Call from the ISR only.
+*
+*******************************************************************************/
+extern void pwm_tick_set2(unsigned int ui_counts);
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for PWM
+*
+* DESCRIPTIONS:
+* Timer 2 matched PR2, a new PWM period has started. Write the new duty cycles
+* of both channels, they are taken by the CCP modules at the start of the
+* following period. If the interrupt is served too close to the next match to
+* write both channels, they are written after that match instead. A late
+* interrupt delays the new duty cycles by a period, it never splits them.
+*
+*******************************************************************************/
+extern void pwm_isr(void);
+
 #endif
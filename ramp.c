@@ -0,0 +1,343 @@
+/*******************************************************************************
+* This file provides the functions for the motor speed ramp on MC40SE, the
+* duty cycle of PWM1 and PWM2 is moved to its target at a limited rate by the
+* 1ms system tick
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#include <htc.h>
+#include "system.h"
+#include "ramp.h"
+#include "pwm.h"
+
+
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+#define RAMP_CHANNELS		2		// PWM1 and PWM2
+
+#define RAMP_MAX_SPEED		1023
+
+// Limit a signed speed and rescale it like set_pwm, so ramp_tick does not need
+// to multiply. Macros, they do not add to the call depth of the main program.
+#define RAMP_LIMIT(speed)	do {\
+								if ((speed) > RAMP_MAX_SPEED) (speed) = RAMP_MAX_SPEED;\
+								else if ((speed) < -RAMP_MAX_SPEED) (speed) = -RAMP_MAX_SPEED;\
+							} while (0)
+#define RAMP_COUNTS(speed)	(((speed) < 0) ? -(int)PWM_SCALE(-(speed)) : (int)PWM_SCALE(speed))
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+// Signed duty cycles in counts of the PWM profile, index 0 = PWM1, 1 = PWM2.
+// The targets are written by the main program, the outputs by ramp_tick (ISR).
+static int i_ramp_target[RAMP_CHANNELS] = {0, 0};
+static volatile int i_ramp_output[RAMP_CHANNELS] = {0, 0};
+
+// Steps per ms in counts of the PWM profile.
+static unsigned char uc_ramp_accel = 1;
+static unsigned char uc_ramp_decel = 1;
+
+// 1 = an output has not reached its target, ramp_tick has work to do.
+static volatile unsigned char b_ramp_moving = 0;
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION PROTOTYPES                                                  *
+*******************************************************************************/
+
+unsigned char uc_ramp_step(unsigned char uc_rate);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Stop both ramps at zero speed and take the rates in system.h. PWM and Timer 0
+* must be initialized.
+*
+*******************************************************************************/
+void ramp_init(void)
+{
+	ramp_set_rate(RAMP_ACCEL_PER_MS, RAMP_DECEL_PER_MS);
+	
+	GIE = 0;
+	i_ramp_target[0] = 0;
+	i_ramp_target[1] = 0;
+	i_ramp_output[0] = 0;
+	i_ramp_output[1] = 0;
+	b_ramp_moving = 0;
+	GIE = 1;
+	
+	set_pwm(0, 0);
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_set_rate
+*
+* PARAMETERS:
+* ~ uc_accel	- Duty cycle increase per ms when speeding up, 1 - 255.
+* ~ uc_decel	- Duty cycle decrease per ms when slowing down, 1 - 255.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Change the rates of both ramps, duty cycle in 0 - 1023 per ms. A direction
+* change slows down to zero at uc_decel first.
+*
+*******************************************************************************/
+void ramp_set_rate(unsigned char uc_accel, unsigned char uc_decel)
+{
+	uc_ramp_accel = uc_ramp_step(uc_accel);
+	uc_ramp_decel = uc_ramp_step(uc_decel);
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_set1
+*
+* PARAMETERS:
+* ~ i_speed		- Target of PWM1, -1023 - 1023. The sign is the direction,
+*				  positive for DIR1 = 1.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the target speed of PWM1, see ramp_set.
+*
+*******************************************************************************/
+void ramp_set1(int i_speed)
+{
+	RAMP_LIMIT(i_speed);
+	i_speed = RAMP_COUNTS(i_speed);
+	
+	GIE = 0;
+	i_ramp_target[0] = i_speed;
+	if (i_ramp_output[0] != i_speed) b_ramp_moving = 1;
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_set2
+*
+* PARAMETERS:
+* ~ i_speed		- Target of PWM2, -1023 - 1023. The sign is the direction,
+*				  positive for DIR2 = 1.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the target speed of PWM2, see ramp_set.
+*
+*******************************************************************************/
+void ramp_set2(int i_speed)
+{
+	RAMP_LIMIT(i_speed);
+	i_speed = RAMP_COUNTS(i_speed);
+	
+	GIE = 0;
+	i_ramp_target[1] = i_speed;
+	if (i_ramp_output[1] != i_speed) b_ramp_moving = 1;
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_set
+*
+* PARAMETERS:
+* ~ i_speed1	- Target of PWM1, -1023 - 1023, positive for DIR1 = 1.
+* ~ i_speed2	- Target of PWM2, -1023 - 1023, positive for DIR2 = 1.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the target speed of both channels and return immediately. ramp_tick moves
+* the duty cycles to the targets. DIR1 and DIR2 belong to the ramp, they are
+* only changed while the duty cycle of the channel is zero. Do not use set_pwm
+* while a ramp is moving, or ramp a channel driven by the PID speed loop.
+*
+*******************************************************************************/
+void ramp_set(int i_speed1, int i_speed2)
+{
+	RAMP_LIMIT(i_speed1);
+	i_speed1 = RAMP_COUNTS(i_speed1);
+	RAMP_LIMIT(i_speed2);
+	i_speed2 = RAMP_COUNTS(i_speed2);
+	
+	GIE = 0;	// both channels start on the same tick
+	i_ramp_target[0] = i_speed1;
+	i_ramp_target[1] = i_speed2;
+	if ((i_ramp_output[0] != i_speed1) || (i_ramp_output[1] != i_speed2)) b_ramp_moving = 1;
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_stop
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Slow both channels down to zero, same as ramp_set(0, 0). This function
+* returns immediately, use uc_ramp_busy to know when the motors are stopped.
+*
+*******************************************************************************/
+void ramp_stop(void)
+{
+	GIE = 0;
+	i_ramp_target[0] = 0;
+	i_ramp_target[1] = 0;
+	// Only busy if a motor is still driven, so a stop when stopped is done.
+	if ((i_ramp_output[0] != 0) || (i_ramp_output[1] != 0)) b_ramp_moving = 1;
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_ramp_busy
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ 1 if a channel has not reached its target yet, 0 if both have.
+*
+* DESCRIPTIONS:
+* Check if the ramps are still moving. This function does not block.
+*
+*******************************************************************************/
+unsigned char uc_ramp_busy(void)
+{
+	return b_ramp_moving;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_tick
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Move both duty cycles one step to their targets. Called by the ISR on every
+* 1ms system tick.
+*
+*******************************************************************************/
+void ramp_tick(void)
+{
+	unsigned char uc_channel;
+	int i_output;
+	int i_target;
+	
+	if (b_ramp_moving == 0) return;		// the PWM is left alone when idle
+	b_ramp_moving = 0;
+	
+	for (uc_channel = 0; uc_channel < RAMP_CHANNELS; uc_channel++) {
+		i_output = i_ramp_output[uc_channel];
+		i_target = i_ramp_target[uc_channel];
+		if (i_output == i_target) continue;
+		
+		// The direction pin only changes while the motor is not driven.
+		if (i_output == 0) {
+			if (uc_channel == 0) {
+				DIR1 = (i_target > 0) ? 1 : 0;
+			}
+			else {
+				DIR2 = (i_target > 0) ? 1 : 0;
+			}
+		}
+		
+		// Towards zero is slowing down, it stops at zero on a direction change.
+		if (i_target > i_output) {
+			if (i_output < 0) {
+				i_output += uc_ramp_decel;
+				if (i_output > 0) i_output = 0;
+			}
+			else {
+				i_output += uc_ramp_accel;
+			}
+			if (i_output > i_target) i_output = i_target;
+		}
+		else {
+			if (i_output > 0) {
+				i_output -= uc_ramp_decel;
+				if (i_output < 0) i_output = 0;
+			}
+			else {
+				i_output -= uc_ramp_accel;
+			}
+			if (i_output < i_target) i_output = i_target;
+		}
+		
+		i_ramp_output[uc_channel] = i_output;
+		if (i_output != i_target) b_ramp_moving = 1;
+		
+		// Only a moving channel is written, the other may belong to pid_task.
+		if (i_output < 0) i_output = -i_output;
+		if (uc_channel == 0) {
+			pwm_tick_set1(i_output);
+		}
+		else {
+			pwm_tick_set2(i_output);
+		}
+	}
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: uc_ramp_step
+*
+* PARAMETERS:
+* ~ uc_rate		- Duty cycle change per ms, 0 - 1023 scale.
+*
+* RETURN:
+* ~ The change per ms in counts of the PWM profile, at least 1.
+*
+* DESCRIPTIONS:
+* Rescale a rate, a low rate on a coarse PWM profile still moves.
+*
+*******************************************************************************/
+unsigned char uc_ramp_step(unsigned char uc_rate)
+{
+	unsigned int ui_step = PWM_SCALE(uc_rate);
+	
+	if (ui_step == 0) return 1;
+	return (unsigned char)ui_step;
+}
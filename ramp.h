@@ -0,0 +1,164 @@
+/*******************************************************************************
+* This file provides the functions for the motor speed ramp on MC40SE, the
+* duty cycle of PWM1 and PWM2 is moved to its target at a limited rate by the
+* 1ms system tick
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#ifndef _RAMP_H
+#define _RAMP_H
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION PROTOTYPES                                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Stop both ramps at zero speed and take the rates in system.h. PWM and Timer 0
+* must be initialized.
+*
+*******************************************************************************/
+extern void ramp_init(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_set_rate
+*
+* PARAMETERS:
+* ~ uc_accel	- Duty cycle increase per ms when speeding up, 1 - 255.
+* ~ uc_decel	- Duty cycle decrease per ms when slowing down, 1 - 255.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Change the rates of both ramps, duty cycle in 0 - 1023 per ms. A direction
+* change slows down to zero at uc_decel first.
+*
+*******************************************************************************/
+extern void ramp_set_rate(unsigned char uc_accel, unsigned char uc_decel);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_set1
+*
+* PARAMETERS:
+* ~ i_speed		- Target of PWM1, -1023 - 1023. The sign is the direction,
+*				  positive for DIR1 = 1.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the target speed of PWM1, see ramp_set.
+*
+*******************************************************************************/
+extern void ramp_set1(int i_speed);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_set2
+*
+* PARAMETERS:
+* ~ i_speed		- Target of PWM2, -1023 - 1023. The sign is the direction,
+*				  positive for DIR2 = 1.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the target speed of PWM2, see ramp_set.
+*
+*******************************************************************************/
+extern void ramp_set2(int i_speed);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_set
+*
+* PARAMETERS:
+* ~ i_speed1	- Target of PWM1, -1023 - 1023, positive for DIR1 = 1.
+* ~ i_speed2	- Target of PWM2, -1023 - 1023, positive for DIR2 = 1.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Set the target speed of both channels and return immediately. ramp_tick moves
+* the duty cycles to the targets. DIR1 and DIR2 belong to the ramp, they are
+* only changed while the duty cycle of the channel is zero. Do not use set_pwm
+* while a ramp is moving, or ramp a channel driven by the PID speed loop.
+*
+*******************************************************************************/
+extern void ramp_set(int i_speed1, int i_speed2);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_stop
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Slow both channels down to zero, same as ramp_set(0, 0). This function
+* returns immediately, use uc_ramp_busy to know when the motors are stopped.
+*
+*******************************************************************************/
+extern void ramp_stop(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_ramp_busy
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ 1 if a channel has not reached its target yet, 0 if both have.
+*
+* DESCRIPTIONS:
+* Check if the ramps are still moving. This function does not block.
+*
+*******************************************************************************/
+extern unsigned char uc_ramp_busy(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ramp_tick
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Move both duty cycles one step to their targets. Called by the ISR on every
+* 1ms system tick.
+*
+*******************************************************************************/
+extern void ramp_tick(void);
+
+#endif
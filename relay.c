@@ -0,0 +1,255 @@
+/*******************************************************************************
+* This file provides the functions for the relays and the MD3/MD4 lines behind
+* the 8 bit latch on MC40SE, PIC16F887 or PIC16F877A
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#include <htc.h>
+#include "system.h"
+#include "relay.h"
+#include "bus.h"
+
+
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+// Bit of a latch output in the frame, uc_relay_number is 1 - 8.
+#define RELAY_BIT(uc_relay_number)	(0b00000001 << ((uc_relay_number) - 1))
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+static unsigned char uc_relay_staged = 0;		// frame being built
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION PROTOTYPES                                                  *
+*******************************************************************************/
+
+void relay_strobe(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Clear the frame and turn off all the latch outputs.
+*
+*******************************************************************************/
+void relay_init(void)
+{
+	uc_relay_staged = 0;
+	
+	// The latch outputs are unknown after power up, always strobe.
+	relay_strobe();
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_stage_on
+*
+* PARAMETERS:
+* ~ uc_relay_number	- Latch output to turn on, from 1 - 8.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Turn on one output in the frame. The latch is not changed until
+* relay_commit.
+*
+*******************************************************************************/
+void relay_stage_on(unsigned char uc_relay_number)
+{
+	if ((uc_relay_number == 0) || (uc_relay_number > 8)) return;
+	uc_relay_staged |= RELAY_BIT(uc_relay_number);
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_stage_off
+*
+* PARAMETERS:
+* ~ uc_relay_number	- Latch output to turn off, from 1 - 8.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Turn off one output in the frame. The latch is not changed until
+* relay_commit.
+*
+*******************************************************************************/
+void relay_stage_off(unsigned char uc_relay_number)
+{
+	if ((uc_relay_number == 0) || (uc_relay_number > 8)) return;
+	uc_relay_staged &= ~RELAY_BIT(uc_relay_number);
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_stage_frame
+*
+* PARAMETERS:
+* ~ uc_frame		- All 8 latch outputs, bit 0 is output 1.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Replace the whole frame. The latch is not changed until relay_commit.
+*
+*******************************************************************************/
+void relay_stage_frame(unsigned char uc_frame)
+{
+	uc_relay_staged = uc_frame;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_relay_frame
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ The staged frame, bit 0 is output 1.
+*
+* DESCRIPTIONS:
+* Read the frame, including the changes that are not committed yet.
+*
+*******************************************************************************/
+unsigned char uc_relay_frame(void)
+{
+	return uc_relay_staged;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_commit
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Send the frame to the latch with a single LATCH strobe. Nothing is done if
+* the latch outputs already match the frame. Outputs cut by a limit switch
+* stay off (see limit.h), and come back on the first commit after the switch
+* opens.
+*
+*******************************************************************************/
+void relay_commit(void)
+{
+	// The bus knows the real outputs, a limit switch may have cut one.
+	if (uc_bus_latch_unchanged(uc_relay_staged) == 1) return;
+	relay_strobe();
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_on
+*
+* PARAMETERS:
+* ~ uc_relay_number	- Latch output to turn on, from 1 - 8.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Turn on one output and commit the frame.
+*
+*******************************************************************************/
+void relay_on(unsigned char uc_relay_number)
+{
+	relay_stage_on(uc_relay_number);
+	relay_commit();
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_off
+*
+* PARAMETERS:
+* ~ uc_relay_number	- Latch output to turn off, from 1 - 8.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Turn off one output and commit the frame.
+*
+*******************************************************************************/
+void relay_off(unsigned char uc_relay_number)
+{
+	relay_stage_off(uc_relay_number);
+	relay_commit();
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_off_all
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Turn off all the latch outputs and commit the frame.
+*
+*******************************************************************************/
+void relay_off_all(void)
+{
+	uc_relay_staged = 0;
+	relay_commit();
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: relay_strobe
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Send the whole frame to the latch in one transaction on the PORTD bus, the
+* LCD tick waits for the next tick if it comes in between.
+*
+*******************************************************************************/
+void relay_strobe(void)
+{
+	while (uc_bus_acquire(BUS_LATCH) == 0) continue;
+	bus_latch_put(uc_relay_staged);
+	bus_release(BUS_LATCH);
+}
@@ -0,0 +1,181 @@
+/*******************************************************************************
+* This file provides the functions for the relays and the MD3/MD4 lines behind
+* the 8 bit latch on MC40SE, PIC16F887 or PIC16F877A
+* Author: Cytron Technologies Sdn. Bhd.
+*
+* The latch outputs are kept in a shadow frame. Changes are staged in the frame
+* and sent to the latch by relay_commit with a single LATCH strobe.
+* Latch output 1 - 4 : Relay 1 - 4
+* Latch output 5 - 8 : MD3 and MD4 lines
+*******************************************************************************/
+
+
+
+#ifndef _RELAY_H
+#define _RELAY_H
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION PROTOTYPES                                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Clear the frame and turn off all the latch outputs.
+*
+*******************************************************************************/
+extern void relay_init(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_stage_on
+*
+* PARAMETERS:
+* ~ uc_relay_number	- Latch output to turn on, from 1 - 8.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Turn on one output in the frame. The latch is not changed until
+* relay_commit.
+*
+*******************************************************************************/
+extern void relay_stage_on(unsigned char uc_relay_number);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_stage_off
+*
+* PARAMETERS:
+* ~ uc_relay_number	- Latch output to turn off, from 1 - 8.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Turn off one output in the frame. The latch is not changed until
+* relay_commit.
+*
+*******************************************************************************/
+extern void relay_stage_off(unsigned char uc_relay_number);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_stage_frame
+*
+* PARAMETERS:
+* ~ uc_frame		- All 8 latch outputs, bit 0 is output 1.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Replace the whole frame. The latch is not changed until relay_commit.
+*
+*******************************************************************************/
+extern void relay_stage_frame(unsigned char uc_frame);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_relay_frame
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ The staged frame, bit 0 is output 1.
+*
+* DESCRIPTIONS:
+* Read the frame, including the changes that are not committed yet.
+*
+*******************************************************************************/
+extern unsigned char uc_relay_frame(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_commit
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Send the frame to the latch with a single LATCH strobe. Nothing is done if
+* the latch outputs already match the frame. Outputs cut by a limit switch
+* stay off (see limit.h), and come back on the first commit after the switch
+* opens.
+*
+*******************************************************************************/
+extern void relay_commit(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_on
+*
+* PARAMETERS:
+* ~ uc_relay_number	- Latch output to turn on, from 1 - 8.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Turn on one output and commit the frame.
+*
+*******************************************************************************/
+extern void relay_on(unsigned char uc_relay_number);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_off
+*
+* PARAMETERS:
+* ~ uc_relay_number	- Latch output to turn off, from 1 - 8.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Turn off one output and commit the frame.
+*
+*******************************************************************************/
+extern void relay_off(unsigned char uc_relay_number);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: relay_off_all
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Turn off all the latch outputs and commit the frame.
+*
+*******************************************************************************/
+extern void relay_off_all(void);
+
+
+
+#endif
@@ -0,0 +1,124 @@
+/*******************************************************************************
+* This file provides the functions for the cooperative task scheduler on
+* MC40SE, tasks run at their own period from the main loop on the 1ms system
+* tick
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#include <htc.h>
+#include "system.h"
+#include "sched.h"
+#include "timer0.h"
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+// Task table, in program memory.
+static const SCHED_TASK* cs_sched_tasks = 0;
+static unsigned char uc_sched_count = 0;
+
+// System tick when each task is due next.
+static unsigned int ui_sched_due[SCHED_MAX_TASKS];
+
+// Runs of each task longer than its budget.
+static unsigned char uc_sched_overrun[SCHED_MAX_TASKS];
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: sched_start
+*
+* PARAMETERS:
+* ~ cs_tasks	- Task table in program memory, the first task has the highest
+*				  priority.
+* ~ uc_count	- Number of tasks, not more than SCHED_MAX_TASKS.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Start the schedule, every task is due at once. Timer 0 must be initialized.
+*
+*******************************************************************************/
+void sched_start(const SCHED_TASK* cs_tasks, unsigned char uc_count)
+{
+	unsigned char uc_task;
+	unsigned int ui_now = ui_millis();
+	
+	if (uc_count > SCHED_MAX_TASKS) uc_count = SCHED_MAX_TASKS;
+	
+	for (uc_task = 0; uc_task < uc_count; uc_task++) {
+		ui_sched_due[uc_task] = ui_now;
+		uc_sched_overrun[uc_task] = 0;
+	}
+	cs_sched_tasks = cs_tasks;
+	uc_sched_count = uc_count;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: sched_run
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Run the first task that is due and return, call it from the main loop. A task
+* runs again one period after it was due, a task that is late by more than a
+* period loses the runs it missed.
+*
+*******************************************************************************/
+void sched_run(void)
+{
+	unsigned char uc_task;
+	unsigned int ui_now = ui_millis();
+	unsigned int ui_start;
+	
+	for (uc_task = 0; uc_task < uc_sched_count; uc_task++) {
+		if (MILLIS_PASSED(ui_now, ui_sched_due[uc_task])) break;
+	}
+	if (uc_task >= uc_sched_count) return;		// nothing is due
+	
+	ui_sched_due[uc_task] += cs_sched_tasks[uc_task].ui_period_ms;
+	if (MILLIS_PASSED(ui_now, ui_sched_due[uc_task])) {
+		ui_sched_due[uc_task] = ui_now + cs_sched_tasks[uc_task].ui_period_ms;
+	}
+	
+	ui_start = ui_millis();
+	cs_sched_tasks[uc_task].pf_task();
+	
+	// Measured on the 1ms tick, a run may read up to 1ms longer than it is.
+	if ((ui_millis() - ui_start) > cs_sched_tasks[uc_task].uc_budget_ms) {
+		if (uc_sched_overrun[uc_task] != 255) uc_sched_overrun[uc_task]++;
+	}
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_sched_overruns
+*
+* PARAMETERS:
+* ~ uc_task		- Index of the task in the table.
+*
+* RETURN:
+* ~ Number of runs longer than the budget of the task, stops at 255.
+*
+* DESCRIPTIONS:
+* Check if a task takes longer than its budget and delays the others.
+*
+*******************************************************************************/
+unsigned char uc_sched_overruns(unsigned char uc_task)
+{
+	if (uc_task >= uc_sched_count) return 0;
+	return uc_sched_overrun[uc_task];
+}
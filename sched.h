@@ -0,0 +1,102 @@
+/*******************************************************************************
+* This file provides the functions for the cooperative task scheduler on
+* MC40SE, tasks run at their own period from the main loop on the 1ms system
+* tick
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+// One task of the schedule, the task function must return quickly.
+typedef struct {
+	void (*pf_task)(void);			// task function
+	unsigned int ui_period_ms;		// run every period
+	unsigned char uc_budget_ms;		// longest expected run plus 1ms, a longer run is an overrun
+} SCHED_TASK;
+
+// Protothread, lets a task function wait without blocking. The function
+// returns at a wait and carries on from there on its next run. Local variables
+// are lost at a wait, keep them static. Do not use switch around a wait, and
+// put only one wait on a line.
+//
+//	static PT pt_task = 0;
+//	static unsigned int ui_wait;
+//	void task(void)
+//	{
+//		PT_BEGIN(pt_task);
+//		LED1 = 1;
+//		PT_DELAY(pt_task, ui_wait, 500);
+//		LED1 = 0;
+//		PT_WAIT_UNTIL(pt_task, SW1 == 0);
+//		PT_END(pt_task);
+//	}
+typedef unsigned int PT;
+#define PT_BEGIN(pt)				switch (pt) { case 0:
+#define PT_WAIT_UNTIL(pt, cond)		(pt) = __LINE__; case __LINE__: if (!(cond)) return
+#define PT_YIELD(pt)				(pt) = __LINE__; return; case __LINE__:
+#define PT_DELAY(pt, ui_wait, ms)	(ui_wait) = ui_deadline(ms); PT_WAIT_UNTIL(pt, uc_deadline_passed(ui_wait))
+#define PT_END(pt)					} (pt) = 0
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION PROTOTYPES                                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* PUBLIC FUNCTION: sched_start
+*
+* PARAMETERS:
+* ~ cs_tasks	- Task table in program memory, the first task has the highest
+*				  priority.
+* ~ uc_count	- Number of tasks, not more than SCHED_MAX_TASKS.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Start the schedule, every task is due at once. Timer 0 must be initialized.
+*
+*******************************************************************************/
+extern void sched_start(const SCHED_TASK* cs_tasks, unsigned char uc_count);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: sched_run
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Run the first task that is due and return, call it from the main loop. A task
+* runs again one period after it was due, a task that is late by more than a
+* period loses the runs it missed.
+*
+*******************************************************************************/
+extern void sched_run(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_sched_overruns
+*
+* PARAMETERS:
+* ~ uc_task		- Index of the task in the table.
+*
+* RETURN:
+* ~ Number of runs longer than the budget of the task, stops at 255.
+*
+* DESCRIPTIONS:
+* Check if a task takes longer than its budget and delays the others.
+*
+*******************************************************************************/
+extern unsigned char uc_sched_overruns(unsigned char uc_task);
+
+#endif
@@ -10,6 +10,114 @@
 #include "system.h"
 #include "skps.h"
 #include "uart.h"
+#include "timer0.h"
+
+
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+// The reply is polled in steps of this many micro seconds.
+#define SKPS_POLL_STEP_US		100
+
+// State of the background poller.
+#define POLL_STOPPED			0	// not running, uc_skps talks to SKPS directly
+#define POLL_WAIT_REPLY			1	// command sent, waiting for its reply
+#define POLL_SEND				2	// UART transmit buffer was full, send on next tick
+#define POLL_RESET_HOLD			3	// link lost, SKPS held in reset
+#define POLL_RESET_RELEASE		4	// SKPS released from reset, waiting for it to start
+#define POLL_DISCARD			5	// reply timed out, a late reply is dropped before the next send
+
+// The reply SKPS gives when nothing on the PS2 controller is touched, used in
+// place of a missing reply: released buttons (active low), centred joystick
+// positions, joystick axes not pushed and a disconnected controller.
+#define SKPS_IDLE_VALUE(uc_command)	(((uc_command) <= p_square) ? 1 : (((uc_command) <= p_joy_ry) ? 128 : 0))
+
+// Set every polled value to released / centred and mark it not valid.
+#define SKPS_CACHE_IDLE()	do {\
+								unsigned char uc_idle;\
+								for (uc_idle = 0; uc_idle <= p_con_status; uc_idle++) {\
+									uc_cache[uc_idle] = SKPS_IDLE_VALUE(uc_idle);\
+								}\
+								ul_cache_valid = 0;\
+							} while (0)
+
+// Link supervision state machine, see uc_skps_link_update. b_lost is set to 1
+// if the link has just been declared lost, else 0.
+#define SKPS_LINK_UPDATE(uc_command, uc_status, b_lost)	do {\
+								(b_lost) = 0;\
+								if ((uc_status) == SKPS_OK) {\
+									uc_misses = 0;\
+									uc_link_state = SKPS_LINK_UP;\
+								}\
+								else {\
+									if (((uc_command) <= p_con_status) && (uc_timeouts[uc_command] < 255)) {\
+										uc_timeouts[uc_command]++;\
+									}\
+									if (++uc_misses < SKPS_MAX_MISSES) {\
+										if (uc_link_state == SKPS_LINK_UP) uc_link_state = SKPS_LINK_SUSPECT;\
+									}\
+									else {\
+										uc_misses = 0;\
+										uc_link_state = SKPS_LINK_LOST;\
+										(b_lost) = 1;\
+									}\
+								}\
+							} while (0)
+
+// Timing of the SKPS reset done by the poller, same as skps_reset.
+#define POLL_RESET_HOLD_MS		20
+#define POLL_RESET_RELEASE_MS	40
+
+// After a timeout, the receive buffer is emptied this long before the next
+// command, else a late reply would be taken as the answer to it.
+#define POLL_DISCARD_MS			SKPS_REPLY_TIMEOUT_MS
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+// Number of timeouts for every command, p_select to p_con_status.
+static unsigned char uc_timeouts[p_con_status + 1];
+
+// Link supervision.
+static unsigned char uc_link_state = SKPS_LINK_UP;
+static unsigned char uc_misses = 0;				// consecutive timeouts
+static void (*pf_link_failsafe)(void) = 0;		// called when the link is lost
+static volatile unsigned char b_failsafe_due = 0;	// 1 = the poller lost the link, see skps_poll_failsafe
+
+// Background poller, run from the UART receive and Timer 0 interrupts.
+static const SKPS_POLL_ENTRY* cs_poll_schedule;
+static unsigned char uc_poll_count = 0;			// number of schedule entries, 0 when stopped
+static volatile unsigned char uc_poll_state = POLL_STOPPED;
+static unsigned char uc_poll_index = 0;			// schedule entry being polled
+static unsigned char uc_poll_cycle = 0;			// count the passes through the schedule
+static unsigned int ui_poll_time = 0;			// when the command was sent or the reset phase began
+static volatile unsigned char uc_vib_motor = 0;	// vibrate command waiting to be sent, 0 for none
+static volatile unsigned char uc_vib_value = 0;
+
+// Latest polled value of every command and the tick it was received.
+static volatile unsigned char uc_cache[p_con_status + 1];
+static volatile unsigned int ui_cache_time[p_con_status + 1];
+static volatile unsigned long ul_cache_valid = 0;	// bit n set = uc_cache[n] is valid
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION PROTOTYPES                                                  *
+*******************************************************************************/
+
+unsigned char uc_skps_wait_reply(unsigned char uc_command, unsigned char* puc_reply);
+void skps_flush_replies(void);
+unsigned char uc_skps_link_update(unsigned char uc_command, unsigned char uc_status);
+unsigned char uc_skps_tick_link_update(unsigned char uc_command, unsigned char uc_status);
+void skps_link_lost(void);
+void skps_snapshot_store(SKPS_SNAPSHOT* ps_snapshot, unsigned char uc_command, unsigned char uc_reply);
+void skps_poll_send_next(void);
+void skps_poll_failsafe(void);
 
 
 
@@ -23,18 +131,290 @@
 * ~ data received from SKPS, the status 
 *
 * DESCRIPTIONS:
-* request SKPS button and joystick status
+* request SKPS button and joystick status. If SKPS does not answer in time, the
+* value of a released button or centred joystick is returned instead.
 *
 *******************************************************************************/
 unsigned char uc_skps(unsigned char uc_data)
 {
+	unsigned char uc_reply = 0;
+	
+	// the background poller already has it
+	if (uc_poll_count != 0) {
+		skps_poll_failsafe();
+		if (uc_data > p_con_status) return 0;
+		return uc_cache[uc_data];
+	}
+	
 	// send command to request PS2 status
-	uart_tx(uc_data);
-	return uc_uart_rx();
+	if (uc_skps_transaction(uc_data, &uc_reply) != SKPS_OK) {
+		uc_reply = SKPS_IDLE_VALUE(uc_data);
+	}
+	return uc_reply;
 }	
 
 
 
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_skps_transaction
+*
+* PARAMETERS:
+* ~ uc_command	- SKPS command constant, p_select to p_con_status
+* ~ puc_reply	- where to store the reply from SKPS
+*
+* RETURN:
+* ~ SKPS_OK if a reply is received, SKPS_TIMEOUT if SKPS does not answer in time
+*
+* DESCRIPTIONS:
+* send one command to SKPS and wait at most SKPS_REPLY_TIMEOUT_MS for its reply.
+* Every result is fed to the link supervision.
+*
+*******************************************************************************/
+unsigned char uc_skps_transaction(unsigned char uc_command, unsigned char* puc_reply)
+{
+	// drop late replies of earlier timeouts, else every reply after it is shifted
+	skps_flush_replies();
+	
+	// send command to request PS2 status
+	uart_tx(uc_command);
+	
+	// wait for the reply, but not forever
+	return uc_skps_wait_reply(uc_command, puc_reply);
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_skps_snapshot
+*
+* PARAMETERS:
+* ~ ps_snapshot		- where to store the state of the PS2 controller
+* ~ cuc_commands	- list of SKPS commands to read, p_select to p_con_status
+* ~ uc_count		- number of commands in the list
+*
+* RETURN:
+* ~ SKPS_OK if every command is answered, else SKPS_TIMEOUT
+*
+* DESCRIPTIONS:
+* read a list of buttons and joystick axes in one burst. Up to
+* SKPS_PIPELINE_DEPTH commands are sent ahead of their replies, so the commands
+* and replies share the wire instead of taking turns. Items not in the list, or
+* not answered, read as released / centred.
+*
+*******************************************************************************/
+unsigned char uc_skps_snapshot(SKPS_SNAPSHOT* ps_snapshot, const unsigned char* cuc_commands, unsigned char uc_count)
+{
+	unsigned char uc_sent = 0;
+	unsigned char uc_received = 0;
+	unsigned char uc_command;
+	unsigned char uc_reply;
+	
+	// start from a controller nobody touches
+	ps_snapshot->ui_buttons = 0;
+	for (uc_command = p_joy_lx; uc_command <= p_joy_rr; uc_command++) {
+		ps_snapshot->uc_axis[uc_command - p_joy_lx] = SKPS_IDLE_VALUE(uc_command);
+	}
+	ps_snapshot->uc_con_status = 0;
+	ps_snapshot->uc_status = SKPS_OK;
+	
+	// the background poller already has them
+	if (uc_poll_count != 0) {
+		skps_poll_failsafe();
+		for (uc_received = 0; uc_received < uc_count; uc_received++) {
+			uc_command = cuc_commands[uc_received];
+			if (uc_command <= p_con_status) {
+				skps_snapshot_store(ps_snapshot, uc_command, uc_cache[uc_command]);
+			}
+		}
+		if (uc_link_state == SKPS_LINK_LOST) ps_snapshot->uc_status = SKPS_TIMEOUT;
+		return ps_snapshot->uc_status;
+	}
+	
+	skps_flush_replies();
+	
+	while (uc_received < uc_count) {
+		// keep the pipeline full
+		while ((uc_sent < uc_count) && ((unsigned char)(uc_sent - uc_received) < SKPS_PIPELINE_DEPTH)) {
+			uart_tx(cuc_commands[uc_sent++]);
+		}
+		
+		// replies come back in the order the commands were sent
+		uc_command = cuc_commands[uc_received];
+		if (uc_skps_wait_reply(uc_command, &uc_reply) != SKPS_OK) {
+			// the replies still in flight can not be matched any more,
+			// the next transaction will flush them
+			ps_snapshot->uc_status = SKPS_TIMEOUT;
+			break;
+		}
+		uc_received++;
+		skps_snapshot_store(ps_snapshot, uc_command, uc_reply);
+	}
+	
+	return ps_snapshot->uc_status;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: skps_poll_start
+*
+* PARAMETERS:
+* ~ cs_schedule	- list of SKPS commands to poll with their priority class
+* ~ uc_count	- number of entries in the list
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* start the background poller. It walks the schedule from the UART receive and
+* Timer 0 interrupts, one poll cycle is one pass through the list, and keeps the
+* latest reply of every command with the time it was received. The schedule
+* must stay valid while the poller runs. Timer 0 must be initialized.
+* When the link is lost, the polled values go back to released / centred, the
+* failsafe function is called by the next uc_skps or uc_skps_snapshot, and the
+* SKPS is reset in the background.
+*
+*******************************************************************************/
+void skps_poll_start(const SKPS_POLL_ENTRY* cs_schedule, unsigned char uc_count)
+{
+	if (uc_count == 0) return;
+	
+	GIE = 0;		// the poller ISRs must not run half way through
+	cs_poll_schedule = cs_schedule;
+	uc_poll_count = uc_count;
+	b_failsafe_due = 0;
+	SKPS_CACHE_IDLE();
+	
+	// the first call to skps_poll_send_next wraps to entry 0 of cycle 0,
+	// the first command is sent by the next tick
+	uc_poll_index = uc_count - 1;
+	uc_poll_cycle = 0xFF;
+	uc_poll_state = POLL_SEND;
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: skps_poll_stop
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* stop the background poller, uc_skps talks to SKPS directly again.
+*
+*******************************************************************************/
+void skps_poll_stop(void)
+{
+	GIE = 0;
+	uc_poll_state = POLL_STOPPED;
+	uc_poll_count = 0;
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_skps_age
+*
+* PARAMETERS:
+* ~ uc_command	- SKPS command constant, p_select to p_con_status
+*
+* RETURN:
+* ~ milliseconds since the polled value of this command was received,
+*   0xFFFF if there is no valid value
+*
+* DESCRIPTIONS:
+* get how fresh the polled value of a command is.
+*
+*******************************************************************************/
+unsigned int ui_skps_age(unsigned char uc_command)
+{
+	unsigned int ui_time;
+	
+	if (uc_command > p_con_status) return 0xFFFF;
+	
+	GIE = 0;		// the time is 2 bytes, keep the ISR from changing it half way
+	if ((ul_cache_valid & (1UL << uc_command)) == 0) {
+		GIE = 1;
+		return 0xFFFF;
+	}
+	ui_time = ui_cache_time[uc_command];
+	GIE = 1;
+	
+	return ui_millis() - ui_time;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: skps_set_failsafe
+*
+* PARAMETERS:
+* ~ pf_failsafe	- function to call when the link is lost, 0 for none
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* register the function that brings the robot to a safe state, normally the one
+* that stops the motors. It is called before the SKPS is reset. With the
+* background poller it is called by the next uc_skps or uc_skps_snapshot after
+* the link is lost, from the main program.
+*
+*******************************************************************************/
+void skps_set_failsafe(void (*pf_failsafe)(void))
+{
+	pf_link_failsafe = pf_failsafe;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_skps_link_state
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ SKPS_LINK_UP, SKPS_LINK_SUSPECT or SKPS_LINK_LOST
+*
+* DESCRIPTIONS:
+* get the state of the SKPS link supervision.
+*
+*******************************************************************************/
+unsigned char uc_skps_link_state(void)
+{
+	return uc_link_state;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_skps_timeout_count
+*
+* PARAMETERS:
+* ~ uc_command	- SKPS command constant, p_select to p_con_status
+*
+* RETURN:
+* ~ number of timeouts of this command, stop at 255
+*
+* DESCRIPTIONS:
+* get how many times SKPS did not answer this command.
+*
+*******************************************************************************/
+unsigned char uc_skps_timeout_count(unsigned char uc_command)
+{
+	if (uc_command > p_con_status) return 0;
+	return uc_timeouts[uc_command];
+}
+
+
+
 /*******************************************************************************
 * PUBLIC FUNCTION: skps_vibrate
 *
@@ -50,6 +430,15 @@ unsigned char uc_skps(unsigned char uc_data)
 *******************************************************************************/
 void skps_vibrate(unsigned char uc_motor, unsigned char uc_value)
 {
+	// let the background poller send it between two polls
+	if (uc_poll_count != 0) {
+		GIE = 0;
+		uc_vib_value = uc_value;
+		uc_vib_motor = uc_motor;
+		GIE = 1;
+		return;
+	}
+	
 	uart_tx(uc_motor);		//send number of motor, motor 1 or motor 2 to SKPS
 	uart_tx(uc_value);		//send the speed, activate or deactivate command to SKPS	
 }	
@@ -72,9 +461,346 @@ void skps_reset(void)
 {
 #if defined(_16F887)	// PIC16F887 have RA6, PIC16F877A does not have
 	SK_R = 1; 			// reset the SKPS
-	__delay_ms(20);		// wait for 20 ms
+	delay_ms(20);		// wait for 20 ms
 	SK_R = 0;			// release reset, SKPS back to normal operation
-	__delay_ms(20);	
+	delay_ms(20);	
 #endif
-	__delay_ms(20);
+	delay_ms(20);
 }	
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: uc_skps_wait_reply
+*
+* PARAMETERS:
+* ~ uc_command	- SKPS command the reply belongs to
+* ~ puc_reply	- where to store the reply from SKPS
+*
+* RETURN:
+* ~ SKPS_OK if a reply is received, SKPS_TIMEOUT if SKPS does not answer in time
+*
+* DESCRIPTIONS:
+* wait at most SKPS_REPLY_TIMEOUT_MS for the next reply, count the timeout
+* against uc_command and feed the result to the link supervision.
+*
+*******************************************************************************/
+unsigned char uc_skps_wait_reply(unsigned char uc_command, unsigned char* puc_reply)
+{
+	unsigned int ui_steps = SKPS_REPLY_TIMEOUT_MS * (1000 / SKPS_POLL_STEP_US);
+	
+	while (uc_uart_try_read(puc_reply) == 0) {
+		if (ui_steps-- == 0) {
+			if (uc_skps_link_update(uc_command, SKPS_TIMEOUT) == 1) {
+				skps_link_lost();
+			}
+			return SKPS_TIMEOUT;
+		}
+		__delay_us(SKPS_POLL_STEP_US);
+	}
+	
+	uc_skps_link_update(uc_command, SKPS_OK);
+	return SKPS_OK;
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: skps_flush_replies
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* drop every byte waiting in the UART receive buffer, these are replies that
+* arrived after their transaction had timed out.
+*
+*******************************************************************************/
+void skps_flush_replies(void)
+{
+	unsigned char uc_stale;
+	
+	while (uc_uart_try_read(&uc_stale) == 1) continue;
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: skps_snapshot_store
+*
+* PARAMETERS:
+* ~ ps_snapshot	- the snapshot to update
+* ~ uc_command	- SKPS command constant, p_select to p_con_status
+* ~ uc_reply	- reply from SKPS to this command
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* put one reply into its place in the snapshot.
+*
+*******************************************************************************/
+void skps_snapshot_store(SKPS_SNAPSHOT* ps_snapshot, unsigned char uc_command, unsigned char uc_reply)
+{
+	if (uc_command <= p_square) {
+		if (uc_reply == 0) ps_snapshot->ui_buttons |= (1U << uc_command);	// active low
+	}
+	else if (uc_command <= p_joy_rr) {
+		ps_snapshot->uc_axis[uc_command - p_joy_lx] = uc_reply;
+	}
+	else if (uc_command == p_con_status) {
+		ps_snapshot->uc_con_status = uc_reply;
+	}
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: skps_poll_send_next
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* move to the next schedule entry that is due in this poll cycle and send its
+* command. A waiting vibrate command goes out first. If the UART transmit buffer
+* has no space, try again on the next tick instead of waiting. Called by the
+* ISR only.
+*
+*******************************************************************************/
+void skps_poll_send_next(void)
+{
+	unsigned int ui_steps;
+	unsigned char uc_stale;
+	
+	// drop late replies of earlier timeouts
+	while (uc_uart_tick_try_read(&uc_stale) == 1) continue;
+	
+	// SKPS does not reply to the vibrate command
+	if (uc_vib_motor != 0) {
+		if (uc_uart_tick_tx_space() < 2) {
+			uc_poll_state = POLL_SEND;
+			return;
+		}
+		uc_uart_tick_tx(uc_vib_motor);
+		uc_uart_tick_tx(uc_vib_value);
+		uc_vib_motor = 0;
+	}
+	
+	if (uc_uart_tick_tx_space() == 0) {
+		uc_poll_state = POLL_SEND;
+		return;
+	}
+	
+	// every entry is due at least once in SKPS_POLL_SLOW cycles
+	for (ui_steps = (unsigned int)uc_poll_count * SKPS_POLL_SLOW; ui_steps > 0; ui_steps--) {
+		if (++uc_poll_index >= uc_poll_count) {
+			uc_poll_index = 0;
+			uc_poll_cycle++;
+		}
+		if ((uc_poll_cycle & (cs_poll_schedule[uc_poll_index].uc_class - 1)) == 0) break;
+	}
+	
+	uc_uart_tick_tx(cs_poll_schedule[uc_poll_index].uc_command);
+	ui_poll_time = ui_tick_millis();
+	uc_poll_state = POLL_WAIT_REPLY;
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: uc_skps_link_update
+*
+* PARAMETERS:
+* ~ uc_command	- SKPS command of the last transaction
+* ~ uc_status	- SKPS_OK or SKPS_TIMEOUT of the last transaction
+*
+* RETURN:
+* ~ 1 if the link has just been declared lost, else 0
+*
+* DESCRIPTIONS:
+* link supervision state machine. Any reply brings the link back up. Timeouts
+* are counted against uc_command, and after SKPS_MAX_MISSES consecutive ones the
+* link is lost; if SKPS stays silent this repeats every SKPS_MAX_MISSES timeouts.
+* The caller decides how to recover.
+* Main program only, the poller uses uc_skps_tick_link_update.
+*
+*******************************************************************************/
+unsigned char uc_skps_link_update(unsigned char uc_command, unsigned char uc_status)
+{
+	unsigned char b_lost;
+	
+	SKPS_LINK_UPDATE(uc_command, uc_status, b_lost);
+	return b_lost;
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: uc_skps_tick_link_update
+*
+* PARAMETERS:
+* ~ uc_command	- SKPS command of the last poll
+* ~ uc_status	- SKPS_OK or SKPS_TIMEOUT of the last poll
+*
+* RETURN:
+* ~ 1 if the link has just been declared lost, else 0
+*
+* DESCRIPTIONS:
+* same as uc_skps_link_update, for the poller in the ISR only.
+*
+*******************************************************************************/
+unsigned char uc_skps_tick_link_update(unsigned char uc_command, unsigned char uc_status)
+{
+	unsigned char b_lost;
+	
+	SKPS_LINK_UPDATE(uc_command, uc_status, b_lost);
+	return b_lost;
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: skps_link_lost
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* recover a lost link when the main program drives the SKPS: call the failsafe
+* function, then reset the SKPS.
+*
+*******************************************************************************/
+void skps_link_lost(void)
+{
+	if (pf_link_failsafe != 0) {
+		pf_link_failsafe();		// make the robot safe first
+	}
+	skps_reset();
+}
+
+
+
+/*******************************************************************************
+* PRIVATE FUNCTION: skps_poll_failsafe
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* call the failsafe function once after the poller has lost the link. The
+* poller runs in the ISR, so the failsafe is left to the main program read of
+* the polled values. Main program only.
+*
+*******************************************************************************/
+void skps_poll_failsafe(void)
+{
+	if (b_failsafe_due == 0) return;
+	b_failsafe_due = 0;		// before the call, the failsafe may read SKPS
+	
+	if (pf_link_failsafe != 0) {
+		pf_link_failsafe();
+	}
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for the SKPS poller, UART receive
+*
+* DESCRIPTIONS:
+* take the reply of the polled command from the UART receive buffer and send
+* the next command. Call after uart_rx_isr.
+*
+*******************************************************************************/
+void skps_poll_rx(void)
+{
+	unsigned char uc_command;
+	unsigned char uc_reply;
+	
+	if (uc_poll_state != POLL_WAIT_REPLY) return;
+	if (uc_uart_tick_try_read(&uc_reply) == 0) return;
+	
+	uc_command = cs_poll_schedule[uc_poll_index].uc_command;
+	if (uc_command <= p_con_status) {
+		uc_cache[uc_command] = uc_reply;
+		ui_cache_time[uc_command] = ui_tick_millis();
+		ul_cache_valid |= (1UL << uc_command);
+	}
+	uc_skps_tick_link_update(uc_command, SKPS_OK);
+	
+	skps_poll_send_next();
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for the SKPS poller, 1ms tick
+*
+* DESCRIPTIONS:
+* time out missing replies and time the SKPS reset. Call after timer0_isr.
+* The failsafe function is not called from here, the main program calls it
+* through skps_poll_failsafe.
+*
+*******************************************************************************/
+void skps_poll_tick(void)
+{
+	unsigned int ui_elapsed = ui_tick_millis() - ui_poll_time;
+	
+	switch (uc_poll_state) {
+		case POLL_SEND:
+			skps_poll_send_next();
+			break;
+			
+		case POLL_WAIT_REPLY:
+			if (ui_elapsed < SKPS_REPLY_TIMEOUT_MS) break;
+			
+			if (uc_skps_tick_link_update(cs_poll_schedule[uc_poll_index].uc_command, SKPS_TIMEOUT) == 1) {
+				// link lost, let the main program see a controller nobody touches
+				SKPS_CACHE_IDLE();
+				b_failsafe_due = 1;
+#if defined(_16F887)	// PIC16F887 have RA6, PIC16F877A does not have
+				SK_R = 1;			// reset the SKPS
+#endif
+				ui_poll_time = ui_tick_millis();
+				uc_poll_state = POLL_RESET_HOLD;
+			}
+			else {
+				// skip it, try again in its next cycle
+				ui_poll_time = ui_tick_millis();
+				uc_poll_state = POLL_DISCARD;
+			}
+			break;
+			
+		case POLL_DISCARD:
+			if (ui_elapsed < POLL_DISCARD_MS) break;
+			skps_poll_send_next();	// drops the late reply
+			break;
+			
+		case POLL_RESET_HOLD:
+			if (ui_elapsed < POLL_RESET_HOLD_MS) break;
+#if defined(_16F887)
+			SK_R = 0;				// release reset, SKPS back to normal operation
+#endif
+			ui_poll_time = ui_tick_millis();
+			uc_poll_state = POLL_RESET_RELEASE;
+			break;
+			
+		case POLL_RESET_RELEASE:
+			if (ui_elapsed < POLL_RESET_RELEASE_MS) break;
+			skps_poll_send_next();
+			break;
+	}
+}
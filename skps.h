@@ -43,6 +43,38 @@
 #define p_motor1		29
 #define p_motor2		30
 
+//SKPS transaction status
+#define SKPS_OK			0		// reply received
+#define SKPS_TIMEOUT	1		// no reply within SKPS_REPLY_TIMEOUT_MS
+
+//SKPS link state
+#define SKPS_LINK_UP		0	// last transaction was answered
+#define SKPS_LINK_SUSPECT	1	// some consecutive replies are missing
+#define SKPS_LINK_LOST		2	// SKPS_MAX_MISSES reached, failsafe called and SKPS reset
+
+//SKPS snapshot, the state of the PS2 controller collected by uc_skps_snapshot
+typedef struct {
+	unsigned int ui_buttons;				// bit n set = button p_n (p_select to p_square) is pressed
+	unsigned char uc_axis[p_joy_rr - p_joy_lx + 1];	// p_joy_lx to p_joy_rr
+	unsigned char uc_con_status;			// reply to p_con_status
+	unsigned char uc_status;				// SKPS_OK, SKPS_TIMEOUT if any reply is missing
+} SKPS_SNAPSHOT;
+
+//SKPS poller priority class, how often an item is read by the background poller
+#define SKPS_POLL_FAST		1	// every poll cycle
+#define SKPS_POLL_NORMAL	4	// every 4th poll cycle
+#define SKPS_POLL_SLOW		16	// every 16th poll cycle
+
+//one entry of the background poll schedule
+typedef struct {
+	unsigned char uc_command;	// p_select to p_con_status
+	unsigned char uc_class;		// SKPS_POLL_FAST, SKPS_POLL_NORMAL or SKPS_POLL_SLOW
+} SKPS_POLL_ENTRY;
+
+//read a snapshot, b is a button command (p_select to p_square), a is a joystick command (p_joy_lx to p_joy_rr)
+#define SKPS_PRESSED(s, b)	(((s).ui_buttons & (1U << (b))) != 0)
+#define SKPS_AXIS(s, a)		((s).uc_axis[(a) - p_joy_lx])
+
 /*******************************************************************************
 * PUBLIC FUNCTION PROTOTYPES                                                   *
 *******************************************************************************/
@@ -58,13 +90,171 @@
 * ~ data received from SKPS, the status 
 *
 * DESCRIPTIONS:
-* request SKPS button and joystick status
+* request SKPS button and joystick status. While the background poller runs,
+* the latest polled value is returned without waiting.
 *
 *******************************************************************************/
 extern unsigned char uc_skps(unsigned char uc_data);
 
 
 
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_skps_transaction
+*
+* PARAMETERS:
+* ~ uc_command	- SKPS command constant, p_select to p_con_status
+* ~ puc_reply	- where to store the reply from SKPS
+*
+* RETURN:
+* ~ SKPS_OK if a reply is received, SKPS_TIMEOUT if SKPS does not answer in time
+*
+* DESCRIPTIONS:
+* send one command to SKPS and wait at most SKPS_REPLY_TIMEOUT_MS for its reply.
+* Every result is fed to the link supervision. Do not use while the background
+* poller runs.
+*
+*******************************************************************************/
+extern unsigned char uc_skps_transaction(unsigned char uc_command, unsigned char* puc_reply);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_skps_snapshot
+*
+* PARAMETERS:
+* ~ ps_snapshot		- where to store the state of the PS2 controller
+* ~ cuc_commands	- list of SKPS commands to read, p_select to p_con_status
+* ~ uc_count		- number of commands in the list
+*
+* RETURN:
+* ~ SKPS_OK if every command is answered, else SKPS_TIMEOUT
+*
+* DESCRIPTIONS:
+* read a list of buttons and joystick axes in one burst. Up to
+* SKPS_PIPELINE_DEPTH commands are sent ahead of their replies, so the commands
+* and replies share the wire instead of taking turns. Items not in the list, or
+* not answered, read as released / centred.
+* While the background poller runs, the snapshot is taken from the polled values
+* without waiting, and SKPS_TIMEOUT means the link is lost.
+*
+*******************************************************************************/
+extern unsigned char uc_skps_snapshot(SKPS_SNAPSHOT* ps_snapshot, const unsigned char* cuc_commands, unsigned char uc_count);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: skps_poll_start
+*
+* PARAMETERS:
+* ~ cs_schedule	- list of SKPS commands to poll with their priority class
+* ~ uc_count	- number of entries in the list
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* start the background poller. It walks the schedule from the UART receive and
+* Timer 0 interrupts, one poll cycle is one pass through the list, and keeps the
+* latest reply of every command with the time it was received. The schedule
+* must stay valid while the poller runs. Timer 0 must be initialized.
+* When the link is lost, the polled values go back to released / centred, the
+* failsafe function is called by the next uc_skps or uc_skps_snapshot, and the
+* SKPS is reset in the background.
+*
+*******************************************************************************/
+extern void skps_poll_start(const SKPS_POLL_ENTRY* cs_schedule, unsigned char uc_count);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: skps_poll_stop
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* stop the background poller, uc_skps talks to SKPS directly again.
+*
+*******************************************************************************/
+extern void skps_poll_stop(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_skps_age
+*
+* PARAMETERS:
+* ~ uc_command	- SKPS command constant, p_select to p_con_status
+*
+* RETURN:
+* ~ milliseconds since the polled value of this command was received,
+*   0xFFFF if there is no valid value
+*
+* DESCRIPTIONS:
+* get how fresh the polled value of a command is.
+*
+*******************************************************************************/
+extern unsigned int ui_skps_age(unsigned char uc_command);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: skps_set_failsafe
+*
+* PARAMETERS:
+* ~ pf_failsafe	- function to call when the link is lost, 0 for none
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* register the function that brings the robot to a safe state, normally the one
+* that stops the motors. It is called before the SKPS is reset. With the
+* background poller it is called by the next uc_skps or uc_skps_snapshot after
+* the link is lost, from the main program.
+*
+*******************************************************************************/
+extern void skps_set_failsafe(void (*pf_failsafe)(void));
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_skps_link_state
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ SKPS_LINK_UP, SKPS_LINK_SUSPECT or SKPS_LINK_LOST
+*
+* DESCRIPTIONS:
+* get the state of the SKPS link supervision.
+*
+*******************************************************************************/
+extern unsigned char uc_skps_link_state(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_skps_timeout_count
+*
+* PARAMETERS:
+* ~ uc_command	- SKPS command constant, p_select to p_con_status
+*
+* RETURN:
+* ~ number of timeouts of this command, stop at 255
+*
+* DESCRIPTIONS:
+* get how many times SKPS did not answer this command.
+*
+*******************************************************************************/
+extern unsigned char uc_skps_timeout_count(unsigned char uc_command);
+
+
+
 /*******************************************************************************
 * PUBLIC FUNCTION: skps_vibrate
 *
@@ -75,7 +265,8 @@ extern unsigned char uc_skps(unsigned char uc_data);
 * ~ void
 *
 * DESCRIPTIONS:
-* command SKPS to vibrate motor on PS2 controller.
+* command SKPS to vibrate motor on PS2 controller. While the background poller
+* runs, the command is sent between two polls.
 *
 *******************************************************************************/
 extern void skps_vibrate(unsigned char uc_motor, unsigned char uc_value);
@@ -96,4 +287,27 @@ extern void skps_vibrate(unsigned char uc_motor, unsigned char uc_value);
 *******************************************************************************/
 extern void skps_reset(void);
 
+
+
+/*******************************************************************************
+* Interrupt Service Routine for the SKPS poller, UART receive
+*
+* DESCRIPTIONS:
+* take the reply of the polled command from the UART receive buffer and send
+* the next command. Call after uart_rx_isr.
+*
+*******************************************************************************/
+extern void skps_poll_rx(void);
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for the SKPS poller, 1ms tick
+*
+* DESCRIPTIONS:
+* time out missing replies and time the SKPS reset. Call after timer0_isr.
+*
+*******************************************************************************/
+extern void skps_poll_tick(void);
+
 #endif
@@ -53,6 +53,67 @@
 // UART baud rate
 #define UART_BAUD		9600
 
+// UART receive buffer size, filled by the receive interrupt
+// MUST be power of 2 (2, 4, 8, 16, 32...) and not more than 128
+#define UART_RX_BUFFER_SIZE		16
+
+// UART transmit buffer size, drained by the transmit interrupt
+// MUST be power of 2 (2, 4, 8, 16, 32...) and not more than 128
+#define UART_TX_BUFFER_SIZE		32
+
+// SKPS link supervision
+#define SKPS_REPLY_TIMEOUT_MS	10		// longest wait for SKPS to answer one command
+#define SKPS_MAX_MISSES			5		// consecutive timeouts before the link is declared lost
+#define SKPS_PIPELINE_DEPTH		4		// commands sent ahead of their replies in uc_skps_snapshot
+										// MUST be less than UART_RX_BUFFER_SIZE
+
+// Button event queue
+#define EVENT_QUEUE_SIZE		8		// MUST be power of 2 (2, 4, 8, 16...)
+#define EVENT_SWITCH_SAMPLE_MS	10		// SW1 and SW2 are sampled at this period, longer than the bounce
+
+// LCD shadow, written to the LCD in the background by the 1ms system tick
+#define LCD_COLUMNS				8		// 8 for the 2x8 LCD on MC40SE, 16 for a 2x16 LCD
+
+// LCD timing profile, choose one
+#define LCD_TIMING_FAST					// HD44780 datasheet timing, up to 4 bytes every 1ms
+//#define LCD_TIMING_CONSERVATIVE		// extra margin for slow LCD controllers, 1 nibble every 1ms
+
+// ADC scan engine
+#define ADC_MAX_CHANNELS		4		// channels in the scan list
+#define ADC_SOURCE_OHMS			10000	// source impedance of AN0 for ui_adc_read, 10k max
+#define ADC_SAMPLE_PERIOD_MS	1		// a scan of all channels is started every period
+
+// PWM frequency profile for the motor drivers, choose one
+#define PWM_PROFILE_LEGACY				// prescale 4, PR2 = 0xFF: 1.95kHz at 8MHz, 4.9kHz at 20MHz, 10 bits
+//#define PWM_PROFILE_SILENT			// 19.5kHz, above hearing, more switching loss in the driver
+//#define PWM_PROFILE_STANDARD			// 4.9kHz, 408 steps at 8MHz
+//#define PWM_PROFILE_LOW				// 1kHz (1.2kHz at 20MHz), more torque at low speed on brushed motors
+
+// Motor speed ramp, change of the 0 - 1023 duty cycle per 1ms system tick
+#define RAMP_ACCEL_PER_MS		2		// speeding up, 0 to full speed in 0.5s
+#define RAMP_DECEL_PER_MS		4		// slowing down, also down to zero before a direction change
+
+// Encoder velocity, measured on the Timer 1 encoder count by the 1ms system tick
+#define VELOCITY_WINDOW_MS		10		// the counts are taken every window, not more than 255
+#define VELOCITY_MIN_COUNTS		8		// fewer counts in a window use the time between encoder edges
+#define VELOCITY_MIN_SPAN_MS	20		// shortest time between the edges of a period measurement
+#define VELOCITY_STALL_MS		250		// no encoder count for this long is a stall, speed 0
+#define VELOCITY_IIR_SHIFT		2		// filter of the speed, y += (x - y) / 2^n
+
+// PID wheel speed loop on the motor with the encoder, gains x 256 (see pid.h)
+#define PID_PWM_CHANNEL			1		// 1 for PWM1 (jumper RC0=ENC1), 2 for PWM2 (RC0=ENC2)
+#define PID_KP					64		// 0.25 duty per count/s of error
+#define PID_KI					4		// 0.016 duty per count/s of error every VELOCITY_WINDOW_MS
+#define PID_KD					0
+#define PID_KFF					87		// 1023 x 256 / top speed, for 3000 counts/s
+
+// Brushless motor driver reset on BL_R, PIC16F887 only
+#define BLRESET_PULSE_MS		5		// BL_R low
+#define BLRESET_SETTLE_MS		10		// after BL_R is back high
+
+// Task scheduler
+#define SCHED_MAX_TASKS			6		// tasks in the schedule
+
 // I/O Connections.
 // Parallel 2x16 Character LCD
 #define LCD_E			RE2		// E clock pin is connected to RB5	
@@ -101,6 +162,13 @@
 #define SEN7			RA1
 #define SEN8			RA5
 
+// Limit switches of the relay driven motors, active low. A closed limit switch
+// cuts the relay with the same number (see limit.h).
+#define	LIMIT1			SEN1			// Upper limit switch for motor 1, cuts relay 1
+#define LIMIT2			SEN2			// Lower limit switch for motor 1, cuts relay 2
+#define	LIMIT3			SEN3			// Upper limit switch for motor 2, cuts relay 3
+#define LIMIT4			SEN4			// Lower limit switch for motor 2, cuts relay 4
+
 // Relay, to control brushed motor with full speed
 #define LATCH			RC3	//pin that control 8 bit latch further control relay
 #define RELAY1			RD0
@@ -0,0 +1,305 @@
+/*******************************************************************************
+* This file provides the functions for the Timer0 module, use as 1ms system tick
+* on MC40SE, PIC16F887 or PIC16F877A
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#include <htc.h>
+#include "system.h"
+#include "timer0.h"
+
+
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+// Timer 0 counts at FOSC/4 through the prescaler, choose the smallest prescaler
+// that fits 1ms into the 8-bit timer.
+// 8MHz  : 1:8,  250 counts = 2000 cycles
+// 20MHz : 1:32, 156 counts = 4992 cycles
+// The reload in timer0_isr writes TMR0, which clears the prescaler and stops
+// the count for 2 cycles. Each tick is longer by those 2 cycles and the
+// prescaler count at the reload, 2 to TIMER0_PRESCALE + 1 cycles:
+// 8MHz  : 1.001 - 1.0045ms, about 0.3% slow
+// 20MHz : 0.9988 - 1.005ms, about 0.2% slow
+#if ((_XTAL_FREQ / 4000) / 2) <= 256
+#define TIMER0_PRESCALE		2
+#define TIMER0_PS			0b000
+#elif ((_XTAL_FREQ / 4000) / 4) <= 256
+#define TIMER0_PRESCALE		4
+#define TIMER0_PS			0b001
+#elif ((_XTAL_FREQ / 4000) / 8) <= 256
+#define TIMER0_PRESCALE		8
+#define TIMER0_PS			0b010
+#elif ((_XTAL_FREQ / 4000) / 16) <= 256
+#define TIMER0_PRESCALE		16
+#define TIMER0_PS			0b011
+#elif ((_XTAL_FREQ / 4000) / 32) <= 256
+#define TIMER0_PRESCALE		32
+#define TIMER0_PS			0b100
+#else
+#define TIMER0_PRESCALE		64
+#define TIMER0_PS			0b101
+#endif
+
+// Value to add to TMR0 so that it overflows after 1ms.
+#define TIMER0_RELOAD		(256 - ((_XTAL_FREQ / 4000) / TIMER0_PRESCALE))
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+// The system tick, increase every 1ms.
+static volatile unsigned int ui_tick = 0;
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: timer0_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Initialize the Timer 0 module to overflow every 1ms, also enable it for interrupt
+*
+*******************************************************************************/
+void timer0_init(void)
+{
+	T0CS = 0;		// Select internal instruction clock.
+	PSA = 0;		// Prescaler is assigned to Timer 0, not the Watchdog Timer.
+	PS2 = (TIMER0_PS >> 2) & 1;
+	PS1 = (TIMER0_PS >> 1) & 1;
+	PS0 = TIMER0_PS & 1;	// Prescaler, see TIMER0_PRESCALE.
+	
+	TMR0 = TIMER0_RELOAD;
+	T0IF = 0;		// Clear Timer 0 interrupt flag.
+	T0IE = 1;		// Enable Timer 0 overflow interrupt.
+	GIE = 1;		// Enable all unmasked interrupts.
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_millis
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Number of 1ms ticks since timer0_init, roll over after 65535
+*
+* DESCRIPTIONS:
+* Get the system tick in 16-bit.
+*
+*******************************************************************************/
+unsigned int ui_millis(void)
+{
+	unsigned int ui_value;
+	
+	// The tick is 2 bytes, read again if the ISR changed it in between.
+	do {
+		ui_value = ui_tick;
+	} while (ui_value != ui_tick);
+	
+	return ui_value;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_tick_millis
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Number of 1ms ticks since timer0_init, roll over after 65535
+*
+* DESCRIPTIONS:
+* Same as ui_millis, for the ISR only.
+*
+*******************************************************************************/
+unsigned int ui_tick_millis(void)
+{
+	// The ISR can not be interrupted, the tick does not change.
+	return ui_tick;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_deadline
+*
+* PARAMETERS:
+* ~ ui_ms		- Time from now in ms, not more than 32767.
+*
+* RETURN:
+* ~ The system tick ui_ms from now.
+*
+* DESCRIPTIONS:
+* Get a deadline for uc_deadline_passed.
+*
+*******************************************************************************/
+unsigned int ui_deadline(unsigned int ui_ms)
+{
+	return ui_millis() + ui_ms;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_deadline_passed
+*
+* PARAMETERS:
+* ~ ui_deadline	- A deadline from ui_deadline.
+*
+* RETURN:
+* ~ 1 if the deadline has passed, 0 if not yet.
+*
+* DESCRIPTIONS:
+* Check a deadline, correct across the roll over of the system tick as long as
+* the deadline is not more than 32767ms away. This function does not block.
+*
+*******************************************************************************/
+unsigned char uc_deadline_passed(unsigned int ui_deadline)
+{
+	if (MILLIS_PASSED(ui_millis(), ui_deadline)) return 1;
+	return 0;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: delay_ms
+*
+* PARAMETERS:
+* ~ ui_ms		- The period for the delay in miliseconds.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Wait at least ui_ms on the system tick. The interrupts keep running, so the
+* time they take does not stretch the delay. Use a deadline or a software timer
+* instead where the main program has other work to do.
+*
+*******************************************************************************/
+void delay_ms(unsigned int ui_ms)
+{
+	unsigned int ui_start = ui_millis();
+	
+	// The first tick may come at once, wait for one more.
+	while ((ui_millis() - ui_start) <= ui_ms) continue;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: soft_timer_start
+*
+* PARAMETERS:
+* ~ ps_timer	- The software timer.
+* ~ ui_ms		- Time to the first expiry in ms, not more than 32767.
+* ~ ui_period	- Time between the following expiries in ms, 0 for one shot.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Start a software timer, it is checked with uc_soft_timer_expired.
+*
+*******************************************************************************/
+void soft_timer_start(SOFT_TIMER* ps_timer, unsigned int ui_ms, unsigned int ui_period)
+{
+	ps_timer->ui_due = ui_millis() + ui_ms;
+	ps_timer->ui_period = ui_period;
+	ps_timer->b_running = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_soft_timer_expired
+*
+* PARAMETERS:
+* ~ ps_timer	- The software timer.
+*
+* RETURN:
+* ~ 1 once for every expiry, 0 if the timer has not expired or is stopped.
+*
+* DESCRIPTIONS:
+* Check a software timer. A periodic timer is restarted from its due time, so
+* the period does not drift with the time the check is late. If it is late by
+* more than a period, the missed expiries are dropped. A one shot timer stops.
+* This function does not block.
+*
+*******************************************************************************/
+unsigned char uc_soft_timer_expired(SOFT_TIMER* ps_timer)
+{
+	unsigned int ui_now;
+	
+	if (ps_timer->b_running == 0) return 0;
+	
+	ui_now = ui_millis();
+	if (!MILLIS_PASSED(ui_now, ps_timer->ui_due)) return 0;
+	
+	if (ps_timer->ui_period == 0) {
+		ps_timer->b_running = 0;
+	}
+	else {
+		ps_timer->ui_due += ps_timer->ui_period;
+		if (MILLIS_PASSED(ui_now, ps_timer->ui_due)) {
+			ps_timer->ui_due = ui_now + ps_timer->ui_period;	// too late, start again from now
+		}
+	}
+	return 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: soft_timer_stop
+*
+* PARAMETERS:
+* ~ ps_timer	- The software timer.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Stop a software timer.
+*
+*******************************************************************************/
+void soft_timer_stop(SOFT_TIMER* ps_timer)
+{
+	ps_timer->b_running = 0;
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for Timer 0
+*
+* DESCRIPTIONS:
+* This is the ISR for the Timer 0 overflow interrupt, this is to serve as 1ms system tick.
+* TMR0 is added instead of loaded, so the counts made while getting into the ISR
+* are kept, but the write clears the prescaler, see TIMER0_RELOAD.
+*
+*******************************************************************************/
+void timer0_isr(void)
+{
+	TMR0 += TIMER0_RELOAD;
+	
+	// Clear the interrupt flag.
+	T0IF = 0;
+	ui_tick++;
+}
@@ -0,0 +1,200 @@
+/*******************************************************************************
+* This file provides the functions for the Timer0 module, use as 1ms system tick
+* on MC40SE, PIC16F887 or PIC16F877A
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#ifndef _TIMER0_H
+#define _TIMER0_H
+
+// 1 if the system tick now has reached the tick deadline. Correct across the
+// roll over when they are not more than 32767ms apart. A macro, so the ISR can
+// use it too.
+#define MILLIS_PASSED(now, deadline)	((int)((now) - (deadline)) >= 0)
+
+// Software timer, see soft_timer_start.
+typedef struct {
+	unsigned int ui_due;		// system tick of the next expiry
+	unsigned int ui_period;		// ms between expiries, 0 for one shot
+	unsigned char b_running;	// 1 = started and not expired or stopped
+} SOFT_TIMER;
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION PROTOTYPES                                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* PUBLIC FUNCTION: timer0_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Initialize the Timer 0 module to overflow every 1ms, also enable it for interrupt
+*
+*******************************************************************************/
+extern void timer0_init(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_millis
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Number of 1ms ticks since timer0_init, roll over after 65535
+*
+* DESCRIPTIONS:
+* Get the system tick in 16-bit.
+*
+*******************************************************************************/
+extern unsigned int ui_millis(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_tick_millis
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Number of 1ms ticks since timer0_init, roll over after 65535
+*
+* DESCRIPTIONS:
+* Same as ui_millis, for the ISR only.
+*
+*******************************************************************************/
+extern unsigned int ui_tick_millis(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ui_deadline
+*
+* PARAMETERS:
+* ~ ui_ms		- Time from now in ms, not more than 32767.
+*
+* RETURN:
+* ~ The system tick ui_ms from now.
+*
+* DESCRIPTIONS:
+* Get a deadline for uc_deadline_passed.
+*
+*******************************************************************************/
+extern unsigned int ui_deadline(unsigned int ui_ms);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_deadline_passed
+*
+* PARAMETERS:
+* ~ ui_deadline	- A deadline from ui_deadline.
+*
+* RETURN:
+* ~ 1 if the deadline has passed, 0 if not yet.
+*
+* DESCRIPTIONS:
+* Check a deadline, correct across the roll over of the system tick as long as
+* the deadline is not more than 32767ms away. This function does not block.
+*
+*******************************************************************************/
+extern unsigned char uc_deadline_passed(unsigned int ui_deadline);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: delay_ms
+*
+* PARAMETERS:
+* ~ ui_ms		- The period for the delay in miliseconds.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Wait at least ui_ms on the system tick. The interrupts keep running, so the
+* time they take does not stretch the delay. Use a deadline or a software timer
+* instead where the main program has other work to do.
+*
+*******************************************************************************/
+extern void delay_ms(unsigned int ui_ms);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: soft_timer_start
+*
+* PARAMETERS:
+* ~ ps_timer	- The software timer.
+* ~ ui_ms		- Time to the first expiry in ms, not more than 32767.
+* ~ ui_period	- Time between the following expiries in ms, 0 for one shot.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Start a software timer, it is checked with uc_soft_timer_expired.
+*
+*******************************************************************************/
+extern void soft_timer_start(SOFT_TIMER* ps_timer, unsigned int ui_ms, unsigned int ui_period);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_soft_timer_expired
+*
+* PARAMETERS:
+* ~ ps_timer	- The software timer.
+*
+* RETURN:
+* ~ 1 once for every expiry, 0 if the timer has not expired or is stopped.
+*
+* DESCRIPTIONS:
+* Check a software timer. A periodic timer is restarted from its due time, so
+* the period does not drift with the time the check is late. If it is late by
+* more than a period, the missed expiries are dropped. A one shot timer stops.
+* This function does not block.
+*
+*******************************************************************************/
+extern unsigned char uc_soft_timer_expired(SOFT_TIMER* ps_timer);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: soft_timer_stop
+*
+* PARAMETERS:
+* ~ ps_timer	- The software timer.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Stop a software timer.
+*
+*******************************************************************************/
+extern void soft_timer_stop(SOFT_TIMER* ps_timer);
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for Timer 0
+*
+* DESCRIPTIONS:
+* This is the ISR for the Timer 0 overflow interrupt, this is to serve as 1ms system tick.
+*
+*******************************************************************************/
+extern void timer0_isr(void);
+
+#endif
@@ -16,8 +16,8 @@
 * PRIVATE GLOBAL VARIABLES                                                     *
 *******************************************************************************/
 
-// The variables for the encoder.
-static unsigned int encoder = 0;
+// Upper 16 bits of the 32-bit encoder count, Timer 1 is the lower 16 bits.
+static volatile unsigned int ui_encoder_overflow = 0;
 
 
 
@@ -68,14 +68,51 @@ void timer1_init(void)
 * ~ The value for encoder in 16-bit
 *
 * DESCRIPTIONS:
-* Get the value for encoder in 16-bit.
+* Get the lower 16 bits of the encoder count. Timer 1 keeps counting while it
+* is read, TMR1H is read again and the read is repeated if TMR1L has rippled
+* into it.
 *
 *******************************************************************************/
 unsigned int ui_encoder(void)
 {
-	encoder = ((unsigned int)(TMR1H)<<8) | TMR1L;
+	unsigned int ui_value;
+	
+	ENCODER_READ(ui_value);
+	return ui_value;
+}
+
 
-	return encoder;
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ul_encoder
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ The value for encoder in 32-bit
+*
+* DESCRIPTIONS:
+* Get the encoder count in 32-bit, the overflows of Timer 1 counted by
+* timer1_isr are the upper 16 bits. Timer 1 is read like ui_encoder with the
+* interrupt disabled. If it has overflowed and timer1_isr has not counted it yet,
+* TMR1IF is still set and a small count is taken as after the overflow.
+*
+*******************************************************************************/
+unsigned long ul_encoder(void)
+{
+	unsigned int ui_lower;
+	unsigned int ui_upper;
+	
+	GIE = 0;
+	ENCODER_READ(ui_lower);
+	ui_upper = ui_encoder_overflow;
+	if ((TMR1IF == 1) && (ui_lower < 0x8000)) {
+		ui_upper++;		// overflow waiting for timer1_isr
+	}
+	GIE = 1;
+	
+	return ((unsigned long)ui_upper << 16) | ui_lower;
 }
 
 
@@ -89,13 +126,21 @@ unsigned int ui_encoder(void)
 * ~ void
 *
 * DESCRIPTIONS:
-* Set the value for 16-bit encoder.
+* Set the value for 16-bit encoder, the upper 16 bits of the 32-bit count are
+* cleared. Timer 1 is stopped during the write, an asynchronous counter must
+* not count between the writes of TMR1H and TMR1L.
 *
 *******************************************************************************/
 void set_encoder(unsigned int ui_value)
 {
+	GIE = 0;
+	TMR1ON = 0;
 	TMR1H = (unsigned char)(ui_value>>8);
 	TMR1L = (unsigned char)ui_value;
+	TMR1IF = 0;
+	ui_encoder_overflow = 0;
+	TMR1ON = 1;
+	GIE = 1;
 }	
 
 
@@ -104,12 +149,12 @@ void set_encoder(unsigned int ui_value)
 *
 * DESCRIPTIONS:
 * This is the ISR for the Timer 1 overflow interrupt, this is to serve encoder overflow.
-* The ISR will only activate LED on MC40SE as indicator. User are free to modify the ISR
+* The ISR counts the overflow as the upper 16 bits of the encoder count.
 *
 *******************************************************************************/
 void timer1_isr(void)
 {	
 		// Clear the interrupt flag.
 		TMR1IF = 0;		
-		LED1 = 1;
+		ui_encoder_overflow++;
 }
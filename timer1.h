@@ -9,6 +9,14 @@
 #ifndef _TIMER1_H
 #define _TIMER1_H
 
+// Read the 16-bit count of Timer 1 while it is counting. TMR1H is read again
+// and the read is repeated if TMR1L has rippled into it. A macro, so the main
+// program and the ISR do not share a function.
+#define ENCODER_READ(ui_value)	do {\
+									(ui_value) = TMR1H;\
+									(ui_value) = ((ui_value) << 8) | TMR1L;\
+								} while ((unsigned char)((ui_value) >> 8) != TMR1H)
+
 
 
 /*******************************************************************************
@@ -42,12 +50,30 @@ extern void timer1_init(void);
 * ~ The value for encoder in 16-bit
 *
 * DESCRIPTIONS:
-* Get the value for encoder in 16-bit.
+* Get the lower 16 bits of the encoder count, safe while Timer 1 is counting.
 *
 *******************************************************************************/
 extern unsigned int ui_encoder(void);
 
 
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ul_encoder
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ The value for encoder in 32-bit
+*
+* DESCRIPTIONS:
+* Get the encoder count in 32-bit, with the Timer 1 overflows as the upper 16
+* bits. Safe against the overflow interrupt.
+*
+*******************************************************************************/
+extern unsigned long ul_encoder(void);
+
+
 /*******************************************************************************
 * PUBLIC FUNCTION: set_encoder
 *
@@ -58,7 +84,8 @@ extern unsigned int ui_encoder(void);
 * ~ void
 *
 * DESCRIPTIONS:
-* Set the value for 16-bit encoder.
+* Set the value for 16-bit encoder, the upper 16 bits of the 32-bit count are
+* cleared.
 *
 *******************************************************************************/
 extern void set_encoder(unsigned int ui_value);
@@ -68,7 +95,8 @@ extern void set_encoder(unsigned int ui_value);
 * Interrupt Service Routine for Timer 1
 *
 * DESCRIPTIONS:
-* This is the ISR for the Timer 1 overflow interrupt, this is to serve as Real Time Clock.
+* This is the ISR for the Timer 1 overflow interrupt, it counts the upper 16 bits
+* of the encoder count.
 *
 *******************************************************************************/
 extern void timer1_isr(void);
@@ -9,6 +9,44 @@
 #include <htc.h>
 #include "system.h"
 #include "uart.h"
+#include "format.h"
+
+
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+// Take the oldest byte of the receive buffer, it must not be empty.
+#define UART_RX_TAKE(puc_data)	do {\
+									*(puc_data) = uc_rx_buffer[uc_rx_tail];\
+									uc_rx_tail = (uc_rx_tail + 1) & (UART_RX_BUFFER_SIZE - 1);\
+								} while (0)
+
+// Free space in the transmit buffer.
+#define UART_TX_SPACE()			((unsigned char)(uc_tx_tail - uc_tx_head - 1) & (UART_TX_BUFFER_SIZE - 1))
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+// Receive buffer, written by the receive ISR and read by the main program, or
+// by the SKPS poller in the ISR while it runs, never both.
+// uc_rx_head is only changed by the receive ISR and uc_rx_tail only by the
+// reader, so no interrupt masking is needed.
+static volatile unsigned char uc_rx_buffer[UART_RX_BUFFER_SIZE];
+static volatile unsigned char uc_rx_head = 0;
+static volatile unsigned char uc_rx_tail = 0;
+
+// Transmit buffer, written by the main program and the SKPS poller in the ISR,
+// read by the transmit ISR. uc_tx_head is changed by uart_tx with interrupts
+// disabled and by uc_uart_tick_tx in the ISR, uc_tx_tail only by the transmit
+// ISR.
+static volatile unsigned char uc_tx_buffer[UART_TX_BUFFER_SIZE];
+static volatile unsigned char uc_tx_head = 0;
+static volatile unsigned char uc_tx_tail = 0;
 
 
 
@@ -37,6 +75,14 @@ void uart_init(void)
 	CREN = 1;									// Enable reception.
 	TXEN = 1;									// Enable transmission.
 	SYNC = 0;									// Asynchronous communication
+	
+	uc_rx_head = 0;
+	uc_rx_tail = 0;								// Empty the receive buffer.
+	uc_tx_head = 0;
+	uc_tx_tail = 0;								// Empty the transmit buffer.
+	RCIE = 1;									// Enable receive interrupt.
+	PEIE = 1;									// Enable all unmasked peripheral interrupts.
+	GIE = 1;									// Enable all unmasked interrupts.
 }
 
 
@@ -51,18 +97,84 @@ void uart_init(void)
 * ~ void
 *
 * DESCRIPTIONS:
-* This function will transmit one byte of data using UART. This is a blocking
-* function, if the transmit buffer is full, we will wait until the
-* data in the buffer has been sent out before we move in the new data.
+* This function will queue one byte of data for the UART transmit interrupt and
+* return immediately. Only if the transmit buffer is full, we will wait until
+* there is space for the new data. GIE is left as it was. With GIE off, the
+* oldest byte in a full buffer is sent here instead of by the interrupt.
 *
 *******************************************************************************/
 void uart_tx(unsigned char uc_data)
 {
-	// Wait until the transmit buffer is ready for new data.
-	while (TXIF == 0);
+	unsigned char uc_next;
+	unsigned char b_gie = GIE;
+	
+	// Wait until the transmit buffer has space for new data. The SKPS poller
+	// may queue from the ISR, so the head is taken with interrupts disabled.
+	while (1) {
+		GIE = 0;
+		uc_next = (uc_tx_head + 1) & (UART_TX_BUFFER_SIZE - 1);
+		if (uc_next != uc_tx_tail) break;
+		
+		if (b_gie == 1) {
+			GIE = 1;
+		}
+		else {
+			// The transmit ISR can not run, send the oldest byte here.
+			while (TXIF == 0) continue;
+			TXREG = uc_tx_buffer[uc_tx_tail];
+			uc_tx_tail = (uc_tx_tail + 1) & (UART_TX_BUFFER_SIZE - 1);
+		}
+	}
 	
-	// Transmit the data.
-	TXREG = uc_data;
+	// Queue the data and let the transmit ISR send it.
+	uc_tx_buffer[uc_tx_head] = uc_data;
+	uc_tx_head = uc_next;
+	TXIE = 1;
+	GIE = b_gie;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_tx_space
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Number of bytes that can be queued without waiting.
+*
+* DESCRIPTIONS:
+* Check the free space in the transmit buffer. This function does not block.
+*
+*******************************************************************************/
+unsigned char uc_uart_tx_space(void)
+{
+	return UART_TX_SPACE();
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uart_flush
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Wait until every queued byte has been shifted out of the UART.
+*
+*******************************************************************************/
+void uart_flush(void)
+{
+	// Wait until the transmit ISR has emptied the buffer...
+	while (uc_tx_head != uc_tx_tail);
+	
+	// ...and the last byte has left the shift register.
+	while (TRMT == 0);
 }
 
 
@@ -84,20 +196,133 @@ void uart_tx(unsigned char uc_data)
 *******************************************************************************/
 unsigned char uc_uart_rx(void)
 {
-	unsigned char temp = 0;
-	// If there is overrun error...
-	if (OERR == 1) {
-		// Clear the flag by disable and enable back the reception.
-		CREN = 0;
-		CREN = 1;
-		temp = RCREG;	// clear RC register
-	}	
+	unsigned char uc_data = 0;
 	
 	// Wait until there is data available in the receive buffer.
-	while (RCIF == 0);
+	while (uc_uart_try_read(&uc_data) == 0);
 	
 	// Return the received data.
-	return RCREG;
+	return uc_data;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_available
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Number of received bytes waiting in the receive buffer.
+*
+* DESCRIPTIONS:
+* Check how many bytes can be read without waiting. This function does not
+* block.
+*
+*******************************************************************************/
+unsigned char uc_uart_available(void)
+{
+	return (unsigned char)(uc_rx_head - uc_rx_tail) & (UART_RX_BUFFER_SIZE - 1);
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_try_read
+*
+* PARAMETERS:
+* ~ puc_data	- Where to store the received byte.
+*
+* RETURN:
+* ~ 1 if a byte is read into puc_data, 0 if the receive buffer is empty.
+*
+* DESCRIPTIONS:
+* Read one byte from the receive buffer if there is any. This function does
+* not block.
+*
+*******************************************************************************/
+unsigned char uc_uart_try_read(unsigned char* puc_data)
+{
+	// Nothing to read if the buffer is empty.
+	if (uc_rx_head == uc_rx_tail) {
+		return 0;
+	}
+	
+	// Take the oldest byte and free its slot.
+	UART_RX_TAKE(puc_data);
+	return 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_tick_tx
+*
+* PARAMETERS:
+* ~ uc_data		- The data that we want to transmit.
+*
+* RETURN:
+* ~ 1 if the data is queued, 0 if the transmit buffer is full.
+*
+* DESCRIPTIONS:
+* Same as uart_tx, for the ISR only. It never waits, a full buffer drops the
+* data.
+*
+*******************************************************************************/
+unsigned char uc_uart_tick_tx(unsigned char uc_data)
+{
+	unsigned char uc_next = (uc_tx_head + 1) & (UART_TX_BUFFER_SIZE - 1);
+	
+	if (uc_next == uc_tx_tail) return 0;
+	
+	uc_tx_buffer[uc_tx_head] = uc_data;
+	uc_tx_head = uc_next;
+	TXIE = 1;
+	return 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_tick_tx_space
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Number of bytes that uc_uart_tick_tx can queue.
+*
+* DESCRIPTIONS:
+* Same as uc_uart_tx_space, for the ISR only.
+*
+*******************************************************************************/
+unsigned char uc_uart_tick_tx_space(void)
+{
+	return UART_TX_SPACE();
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_tick_try_read
+*
+* PARAMETERS:
+* ~ puc_data	- Where to store the received byte.
+*
+* RETURN:
+* ~ 1 if a byte is read into puc_data, 0 if the receive buffer is empty.
+*
+* DESCRIPTIONS:
+* Same as uc_uart_try_read, for the ISR only.
+*
+*******************************************************************************/
+unsigned char uc_uart_tick_try_read(unsigned char* puc_data)
+{
+	if (uc_rx_head == uc_rx_tail) return 0;
+	
+	UART_RX_TAKE(puc_data);
+	return 1;
 }
 
 
@@ -112,7 +337,8 @@ unsigned char uc_uart_rx(void)
 * ~ void
 *
 * DESCRIPTIONS:
-* Transmit a string using the UART.
+* Queue a string for transmission using the UART. It returns as soon as the
+* whole string is in the transmit buffer.
 *
 *******************************************************************************/
 void uart_putstr(const char* csz_string)
@@ -125,3 +351,136 @@ void uart_putstr(const char* csz_string)
 		csz_string++;
 	}
 }
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uart_putuint
+*
+* PARAMETERS:
+* ~ ui_value	- The number to transmit.
+* ~ uc_width	- Number of characters, 0 to use as many as needed.
+* ~ c_pad		- Character to fill the front with, '0' or ' '.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Transmit an unsigned number in decimal.
+*
+*******************************************************************************/
+void uart_putuint(unsigned int ui_value, unsigned char uc_width, char c_pad)
+{
+	char sz_number[FORMAT_BUFFER_SIZE];
+	
+	uc_format_uint(sz_number, ui_value, uc_width, c_pad);
+	uart_putstr(sz_number);
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uart_putint
+*
+* PARAMETERS:
+* ~ i_value		- The number to transmit.
+* ~ uc_width	- Number of characters including the sign, 0 to use as many as
+*				  needed.
+* ~ c_pad		- Character to fill the front with, '0' or ' '.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Transmit a signed number in decimal.
+*
+*******************************************************************************/
+void uart_putint(int i_value, unsigned char uc_width, char c_pad)
+{
+	char sz_number[FORMAT_BUFFER_SIZE];
+	
+	uc_format_int(sz_number, i_value, uc_width, c_pad);
+	uart_putstr(sz_number);
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uart_puthex
+*
+* PARAMETERS:
+* ~ ui_value	- The number to transmit.
+* ~ uc_digits	- Number of hex digits, 1 to 4.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Transmit the lowest uc_digits hex digits of a number.
+*
+*******************************************************************************/
+void uart_puthex(unsigned int ui_value, unsigned char uc_digits)
+{
+	char sz_number[FORMAT_BUFFER_SIZE];
+	
+	uc_format_hex(sz_number, ui_value, uc_digits);
+	uart_putstr(sz_number);
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for UART receive
+*
+* DESCRIPTIONS:
+* This is the ISR for the UART receive interrupt, it moves the received byte
+* into the receive buffer. If the buffer is full, the new byte is dropped so the
+* bytes already waiting stay in order.
+*
+*******************************************************************************/
+void uart_rx_isr(void)
+{
+	unsigned char uc_data;
+	unsigned char uc_next;
+	
+	// If there is overrun error...
+	if (OERR == 1) {
+		// Clear the flag by disable and enable back the reception.
+		CREN = 0;
+		CREN = 1;
+	}
+	
+	// Reading RCREG clears the interrupt flag.
+	while (RCIF == 1) {
+		uc_data = RCREG;
+		uc_next = (uc_rx_head + 1) & (UART_RX_BUFFER_SIZE - 1);
+		if (uc_next != uc_rx_tail) {
+			uc_rx_buffer[uc_rx_head] = uc_data;
+			uc_rx_head = uc_next;
+		}
+	}
+}
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for UART transmit
+*
+* DESCRIPTIONS:
+* This is the ISR for the UART transmit interrupt, it moves the next queued byte
+* into the UART. The interrupt is disabled once the buffer is empty, because
+* TXIF stays set for as long as TXREG is empty.
+*
+*******************************************************************************/
+void uart_tx_isr(void)
+{
+	// Nothing left to send, stop the interrupt until uart_tx() queues more.
+	if (uc_tx_head == uc_tx_tail) {
+		TXIE = 0;
+		return;
+	}
+	
+	// Writing TXREG clears the interrupt flag.
+	TXREG = uc_tx_buffer[uc_tx_tail];
+	uc_tx_tail = (uc_tx_tail + 1) & (UART_TX_BUFFER_SIZE - 1);
+}
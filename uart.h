@@ -42,15 +42,50 @@ extern void uart_init(void);
 * ~ void
 *
 * DESCRIPTIONS:
-* This function will transmit one byte of data using UART. This is a blocking
-* function, if the transmit buffer is full, we will wait until the
-* data in the buffer has been sent out before we move in the new data.
+* This function will queue one byte of data for the UART transmit interrupt and
+* return immediately. Only if the transmit buffer is full, we will wait until
+* there is space for the new data. GIE is left as it was. With GIE off, the
+* oldest byte in a full buffer is sent here instead of by the interrupt.
 *
 *******************************************************************************/
 extern void uart_tx(unsigned char uc_data);
 
 
 
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_tx_space
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Number of bytes that can be queued without waiting.
+*
+* DESCRIPTIONS:
+* Check the free space in the transmit buffer. This function does not block.
+*
+*******************************************************************************/
+extern unsigned char uc_uart_tx_space(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uart_flush
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Wait until every queued byte has been shifted out of the UART.
+*
+*******************************************************************************/
+extern void uart_flush(void);
+
+
+
 /*******************************************************************************
 * PUBLIC FUNCTION: uc_uart_rx
 *
@@ -70,6 +105,118 @@ extern unsigned char uc_uart_rx(void);
 
 
 
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_available
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Number of received bytes waiting in the receive buffer.
+*
+* DESCRIPTIONS:
+* Check how many bytes can be read without waiting. This function does not
+* block.
+*
+*******************************************************************************/
+extern unsigned char uc_uart_available(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_try_read
+*
+* PARAMETERS:
+* ~ puc_data	- Where to store the received byte.
+*
+* RETURN:
+* ~ 1 if a byte is read into puc_data, 0 if the receive buffer is empty.
+*
+* DESCRIPTIONS:
+* Read one byte from the receive buffer if there is any. This function does
+* not block.
+*
+*******************************************************************************/
+extern unsigned char uc_uart_try_read(unsigned char* puc_data);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_tick_tx
+*
+* PARAMETERS:
+* ~ uc_data		- The data that we want to transmit.
+*
+* RETURN:
+* ~ 1 if the data is queued, 0 if the transmit buffer is full.
+*
+* DESCRIPTIONS:
+* Same as uart_tx, for the ISR only. It never waits, a full buffer drops the
+* data.
+*
+*******************************************************************************/
+extern unsigned char uc_uart_tick_tx(unsigned char uc_data);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_tick_tx_space
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Number of bytes that uc_uart_tick_tx can queue.
+*
+* DESCRIPTIONS:
+* Same as uc_uart_tx_space, for the ISR only.
+*
+*******************************************************************************/
+extern unsigned char uc_uart_tick_tx_space(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_uart_tick_try_read
+*
+* PARAMETERS:
+* ~ puc_data	- Where to store the received byte.
+*
+* RETURN:
+* ~ 1 if a byte is read into puc_data, 0 if the receive buffer is empty.
+*
+* DESCRIPTIONS:
+* Same as uc_uart_try_read, for the ISR only.
+*
+*******************************************************************************/
+extern unsigned char uc_uart_tick_try_read(unsigned char* puc_data);
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for UART receive
+*
+* DESCRIPTIONS:
+* This is the ISR for the UART receive interrupt, it moves the received byte
+* into the receive buffer.
+*
+*******************************************************************************/
+extern void uart_rx_isr(void);
+
+
+
+/*******************************************************************************
+* Interrupt Service Routine for UART transmit
+*
+* DESCRIPTIONS:
+* This is the ISR for the UART transmit interrupt, it moves the next queued byte
+* into the UART.
+*
+*******************************************************************************/
+extern void uart_tx_isr(void);
+
+
+
 /*******************************************************************************
 * PUBLIC FUNCTION: uart_putstr
 *
@@ -80,11 +227,69 @@ extern unsigned char uc_uart_rx(void);
 * ~ void
 *
 * DESCRIPTIONS:
-* Transmit a string using the UART.
+* Queue a string for transmission using the UART. It returns as soon as the
+* whole string is in the transmit buffer.
 *
 *******************************************************************************/
 extern void uart_putstr(const char* csz_string);
 
 
 
+/*******************************************************************************
+* PUBLIC FUNCTION: uart_putuint
+*
+* PARAMETERS:
+* ~ ui_value	- The number to transmit.
+* ~ uc_width	- Number of characters, 0 to use as many as needed.
+* ~ c_pad		- Character to fill the front with, '0' or ' '.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Transmit an unsigned number in decimal.
+*
+*******************************************************************************/
+extern void uart_putuint(unsigned int ui_value, unsigned char uc_width, char c_pad);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uart_putint
+*
+* PARAMETERS:
+* ~ i_value		- The number to transmit.
+* ~ uc_width	- Number of characters including the sign, 0 to use as many as
+*				  needed.
+* ~ c_pad		- Character to fill the front with, '0' or ' '.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Transmit a signed number in decimal.
+*
+*******************************************************************************/
+extern void uart_putint(int i_value, unsigned char uc_width, char c_pad);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uart_puthex
+*
+* PARAMETERS:
+* ~ ui_value	- The number to transmit.
+* ~ uc_digits	- Number of hex digits, 1 to 4.
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Transmit the lowest uc_digits hex digits of a number.
+*
+*******************************************************************************/
+extern void uart_puthex(unsigned int ui_value, unsigned char uc_digits);
+
+
+
 #endif
@@ -0,0 +1,288 @@
+/*******************************************************************************
+* This file provides the functions for the encoder velocity on MC40SE, measured
+* on the Timer 1 encoder count by the 1ms system tick
+* Author: Cytron Technologies Sdn. Bhd.
+*
+* At high speed the counts in every window of VELOCITY_WINDOW_MS give the
+* speed. At low speed there are too few counts in a window, the time between
+* encoder edges is used instead. An edge is seen by the first tick after it,
+* so its time is known to 1ms, and the edges are taken at least
+* VELOCITY_MIN_SPAN_MS apart to keep the error small.
+*
+* The ISR only keeps the time and the count of the latest edge. The long
+* divides are too slow for the 1ms tick, they are done by velocity_task in the
+* main program.
+*******************************************************************************/
+
+
+
+#include <htc.h>
+#include "system.h"
+#include "velocity.h"
+#include "timer1.h"
+
+
+
+/*******************************************************************************
+* PRIVATE CONSTANTS                                                            *
+*******************************************************************************/
+
+// counts x VELOCITY_ONE x 1000 / ms gives the speed.
+#define VELOCITY_SCALE		(1000UL * VELOCITY_ONE)
+
+// More counts overflow counts x VELOCITY_SCALE, only if velocity_task is very late.
+#define VELOCITY_MAX_COUNTS	(0xFFFFFFFFUL / VELOCITY_SCALE)
+
+
+
+/*******************************************************************************
+* PRIVATE GLOBAL VARIABLES                                                     *
+*******************************************************************************/
+
+// 1 = velocity_init is done, velocity_tick is measuring.
+static volatile unsigned char b_velocity_running = 0;
+
+// Written by velocity_tick.
+static unsigned int ui_time = 0;				// ms, only used for differences
+static unsigned char uc_window_timer = 0;		// ms to the end of the window
+static volatile unsigned char b_window_end = 0;	// 1 = velocity_task is due
+
+// Latest encoder edge, the first tick that saw a new count. Written by
+// velocity_tick, read by velocity_task with the interrupt disabled.
+static unsigned int ui_edge_count = 0;
+static unsigned int ui_edge_time = 0;
+
+// Written by velocity_task.
+static unsigned int ui_window_count = 0;		// encoder count at the start of the window
+static unsigned int ui_window_time = 0;			// time at the start of the window
+static unsigned int ui_ref_count = 0;			// reference edge of the period measurement
+static unsigned int ui_ref_time = 0;
+
+// Speed in counts/s x VELOCITY_ONE, written by velocity_task.
+static unsigned long ul_raw = 0;				// latest measurement
+static unsigned long ul_filtered = 0;			// published speed
+
+// 1 = no encoder edge for VELOCITY_STALL_MS.
+static unsigned char b_stalled = 1;
+
+// 1 = velocity_task has updated the speed, cleared by uc_velocity_new.
+static unsigned char b_new = 0;
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: velocity_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Start the velocity measurement from zero speed. Timer 0 and Timer 1 must be
+* initialized. Call it again after set_encoder.
+*
+*******************************************************************************/
+void velocity_init(void)
+{
+	unsigned int ui_count;
+	
+	GIE = 0;
+	ENCODER_READ(ui_count);
+	ui_window_count = ui_count;
+	ui_edge_count = ui_count;
+	ui_ref_count = ui_count;
+	ui_window_time = ui_time;
+	ui_edge_time = ui_time;
+	ui_ref_time = ui_time;
+	uc_window_timer = VELOCITY_WINDOW_MS;
+	b_window_end = 0;
+	ul_raw = 0;
+	ul_filtered = 0;
+	b_stalled = 1;
+	b_new = 0;
+	b_velocity_running = 1;
+	GIE = 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ul_velocity
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Filtered speed of the encoder in counts/s x VELOCITY_ONE.
+*
+* DESCRIPTIONS:
+* Get the speed of the latest velocity_task. This function does not block.
+*
+*******************************************************************************/
+unsigned long ul_velocity(void)
+{
+	return ul_filtered;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_velocity_stalled
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ 1 if there is no encoder count for VELOCITY_STALL_MS, 0 if it is moving.
+*
+* DESCRIPTIONS:
+* Check if the encoder has stopped, as seen by the latest velocity_task. This
+* function does not block.
+*
+*******************************************************************************/
+unsigned char uc_velocity_stalled(void)
+{
+	return b_stalled;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_velocity_new
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ 1 if velocity_task has updated the speed since the last call, 0 if not.
+*
+* DESCRIPTIONS:
+* Check for a new speed, once for every window. This function does not block.
+*
+*******************************************************************************/
+unsigned char uc_velocity_new(void)
+{
+	if (b_new == 0) return 0;
+	b_new = 0;
+	return 1;
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: velocity_task
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Update the speed once every VELOCITY_WINDOW_MS, returns at once in between.
+* Call it from the main loop or as a task of the scheduler, at least once per
+* window. A late call still gives the right speed over the longer time.
+*
+*******************************************************************************/
+void velocity_task(void)
+{
+	unsigned int ui_now;
+	unsigned int ui_count;
+	unsigned int ui_edge;
+	unsigned int ui_counts;
+	unsigned int ui_span;
+	unsigned long ul_bound;
+	
+	if (b_window_end == 0) return;
+	
+	GIE = 0;
+	b_window_end = 0;
+	ui_now = ui_time;
+	ui_count = ui_edge_count;	// the latest count is the latest edge
+	ui_edge = ui_edge_time;
+	GIE = 1;
+	b_new = 1;
+	
+	ui_counts = ui_count - ui_window_count;
+	ui_span = ui_now - ui_window_time;
+	ui_window_count = ui_count;
+	ui_window_time = ui_now;
+	if (ui_counts != 0) b_stalled = 0;
+	
+	if (ui_counts >= VELOCITY_MIN_COUNTS) {
+		// Count mode, the edge of the next period measurement is the latest one.
+		if (ui_counts > VELOCITY_MAX_COUNTS) ui_counts = VELOCITY_MAX_COUNTS;
+		ul_raw = (unsigned long)ui_counts * VELOCITY_SCALE / ui_span;
+		ui_ref_count = ui_count;
+		ui_ref_time = ui_edge;
+	}
+	else {
+		// Period mode, counts between the reference edge and the latest edge.
+		ui_span = ui_edge - ui_ref_time;
+		if (ui_span >= VELOCITY_MIN_SPAN_MS) {
+			ul_raw = (unsigned long)(ui_count - ui_ref_count) * VELOCITY_SCALE / ui_span;
+			ui_ref_count = ui_count;
+			ui_ref_time = ui_edge;
+		}
+		
+		// The next edge has not come yet, the speed can not be more than one
+		// count in the time since the latest edge.
+		ui_span = ui_now - ui_edge;
+		if (ui_span >= VELOCITY_STALL_MS) {
+			ul_raw = 0;
+			ul_filtered = 0;			// stopped, not slowly filtered to zero
+			b_stalled = 1;
+			ui_ref_count = ui_count;	// restart from the next edge
+			ui_ref_time = ui_edge;
+			return;
+		}
+		else if (ui_span != 0) {
+			ul_bound = VELOCITY_SCALE / ui_span;
+			if (ul_raw > ul_bound) ul_raw = ul_bound;
+		}
+	}
+	
+	// IIR filter, y += (x - y) / 2^n.
+	if (ul_raw >= ul_filtered) {
+		ul_filtered += (ul_raw - ul_filtered) >> VELOCITY_IIR_SHIFT;
+	}
+	else {
+		ul_filtered -= (ul_filtered - ul_raw) >> VELOCITY_IIR_SHIFT;
+	}
+}
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: velocity_tick
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Look for new encoder counts and update the speed at the end of every
+* window. Called by the ISR on every 1ms system tick.
+*
+*******************************************************************************/
+void velocity_tick(void)
+{
+	unsigned int ui_count;
+	
+	if (b_velocity_running == 0) return;
+	
+	ui_time++;
+	ENCODER_READ(ui_count);
+	if (ui_count != ui_edge_count) {
+		ui_edge_count = ui_count;
+		ui_edge_time = ui_time;
+	}
+	
+	if (--uc_window_timer != 0) return;
+	uc_window_timer = VELOCITY_WINDOW_MS;
+	b_window_end = 1;
+}
@@ -0,0 +1,126 @@
+/*******************************************************************************
+* This file provides the functions for the encoder velocity on MC40SE, measured
+* on the Timer 1 encoder count by the 1ms system tick
+* Author: Cytron Technologies Sdn. Bhd.
+*******************************************************************************/
+
+
+
+#ifndef _VELOCITY_H
+#define _VELOCITY_H
+
+// Velocity is in counts/s with 8 fraction bits, 256 = 1 count/s.
+#define VELOCITY_ONE		256
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION PROTOTYPES                                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* PUBLIC FUNCTION: velocity_init
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Start the velocity measurement from zero speed. Timer 0 and Timer 1 must be
+* initialized. Call it again after set_encoder.
+*
+*******************************************************************************/
+extern void velocity_init(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: ul_velocity
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ Filtered speed of the encoder in counts/s x VELOCITY_ONE.
+*
+* DESCRIPTIONS:
+* Get the speed of the latest velocity_task. This function does not block.
+*
+*******************************************************************************/
+extern unsigned long ul_velocity(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_velocity_stalled
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ 1 if there is no encoder count for VELOCITY_STALL_MS, 0 if it is moving.
+*
+* DESCRIPTIONS:
+* Check if the encoder has stopped, as seen by the latest velocity_task. This
+* function does not block.
+*
+*******************************************************************************/
+extern unsigned char uc_velocity_stalled(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: uc_velocity_new
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ 1 if velocity_task has updated the speed since the last call, 0 if not.
+*
+* DESCRIPTIONS:
+* Check for a new speed, once for every window. This function does not block.
+*
+*******************************************************************************/
+extern unsigned char uc_velocity_new(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: velocity_task
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Update the speed once every VELOCITY_WINDOW_MS, returns at once in between.
+* Call it from the main loop or as a task of the scheduler, at least once per
+* window. A late call still gives the right speed over the longer time.
+*
+*******************************************************************************/
+extern void velocity_task(void);
+
+
+
+/*******************************************************************************
+* PUBLIC FUNCTION: velocity_tick
+*
+* PARAMETERS:
+* ~ void
+*
+* RETURN:
+* ~ void
+*
+* DESCRIPTIONS:
+* Take the time of the latest encoder count and end the window for
+* velocity_task. Called by the ISR on every 1ms system tick.
+*
+*******************************************************************************/
+extern void velocity_tick(void);
+
+#endif